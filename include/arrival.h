@@ -0,0 +1,66 @@
+#ifndef ARRIVAL_H
+#define ARRIVAL_H
+
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+#include "code.h"
+
+namespace strsim {
+
+	/**
+	 * Blocks of a trial in increasing order of arrival, handed out one
+	 * by one. The arrival times are copied with the index of their block
+	 * into a binary heap built in linear time, so ordering compares
+	 * values instead of chasing block pointers, and a trial that stops
+	 * decoding after m of n blocks pays O(n + m log n) instead of a full
+	 * sort. Blocks arriving at the same time come in index order.
+	 */
+	class arrival_queue {
+	public:
+		typedef std::vector<coded_block *>::size_type size_type;
+
+		arrival_queue() : _blocks(nullptr) {}
+
+		/** queue the count blocks, which must outlive the queue use */
+		void assign(coded_block * const * blocks, size_type count) {
+			_blocks = blocks;
+			_heap.resize(count);
+			for (size_type i = 0; i < count; ++i) {
+				_heap[i] = entry(blocks[i]->arrieve_time, i);
+			}
+			std::make_heap(_heap.begin(), _heap.end());
+		}
+
+		bool empty(void) const { return _heap.empty(); }
+		/** blocks not handed out yet */
+		size_type size(void) const { return _heap.size(); }
+
+		/** the earliest block not handed out yet, the queue is not empty */
+		coded_block * pop(void) {
+			std::pop_heap(_heap.begin(), _heap.end());
+			coded_block * block = _blocks[_heap.back().index];
+			_heap.pop_back();
+			return block;
+		}
+
+	private:
+		struct entry {
+			time_t time;
+			uint32_t index;
+			entry() {}
+			entry(time_t t, uint32_t i) : time(t), index(i) {}
+			/* reversed, the top of the max-heap is the earliest */
+			bool operator< (const entry &other) const {
+				return time > other.time ||
+					(time == other.time && index > other.index);
+			}
+		};
+		coded_block * const * _blocks;
+		std::vector<entry> _heap;
+	};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef CMF_H
+#define CMF_H
+
+#include <vector>
+#include <string>
+#include <ctime>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+namespace strsim {
+
+	/**
+	 * Bins of the time axis of a @ref basic_cmf: `bins` bins over
+	 * [0, range), of equal width or growing geometrically so that the
+	 * tail is covered with few bins, plus an overflow bin for the
+	 * events at or after the range.
+	 */
+	class time_axis {
+	public:
+		typedef std::vector<time_t>::size_type size_type;
+		enum scale_type { LINEAR, LOG };
+
+		/** bins of width one over the range by default */
+		time_axis(time_t range = 0, size_type bins = 0,
+				scale_type scale = LINEAR) : _scale(scale), _width(1) {
+			if (range <= 0) {
+				_edge.assign(1, 0);
+				return;
+			}
+			if (bins == 0 || bins > size_type(range)) {
+				bins = range;
+			}
+			if (scale == LINEAR) {
+				_width = (range + bins - 1) / bins;
+				bins = (range + _width - 1) / _width;
+				_edge.resize(bins + 1);
+				for (size_type b = 0; b < bins; ++b) {
+					_edge[b] = b * _width;
+				}
+			} else {
+				// geometric edges, at least one apart near zero
+				double step = std::log1p(double(range)) / bins;
+				_edge.resize(bins + 1);
+				_edge[0] = 0;
+				for (size_type b = 1; b < bins; ++b) {
+					time_t e = time_t(std::ceil(std::expm1(b * step)));
+					_edge[b] = std::max(e, _edge[b - 1] + 1);
+				}
+			}
+			_edge[bins] = range;
+		}
+
+		/**
+		 * @brief the axis of the STRSIM_TIME_AXIS environment variable,
+		 * "range[:bins[:linear|log]]" in time units, or of the given
+		 * defaults if it is not set.
+		 */
+		static time_axis from_env(time_t range, size_type bins = 0,
+				scale_type scale = LINEAR) {
+			const char * env = std::getenv("STRSIM_TIME_AXIS");
+			if (env == nullptr) {
+				return time_axis(range, bins, scale);
+			}
+			std::string spec(env);
+			char * end = nullptr;
+			range = std::strtoll(spec.c_str(), &end, 0);
+			bins = (*end == ':') ? std::strtoull(end + 1, &end, 0) : 0;
+			if (*end == ':') {
+				scale = (std::string(end + 1) == "log") ? LOG : LINEAR;
+			}
+			return time_axis(range, bins, scale);
+		}
+
+		/** bins within the range, the overflow bin comes after them */
+		size_type bins(void) const { return _edge.size() - 1; }
+		time_t range(void) const { return _edge.back(); }
+		scale_type scale(void) const { return _scale; }
+
+		/** bin of time t, bins() past the range */
+		size_type bin(time_t t) const {
+			if (t <= 0) {
+				return 0;
+			}
+			if (t >= range()) {
+				return bins();
+			}
+			if (_scale == LINEAR) {
+				return t / _width;
+			}
+			return std::upper_bound(_edge.begin(), _edge.end(), t) -
+				_edge.begin() - 1;
+		}
+
+		/** first time of bin b */
+		time_t start(size_type b) const { return _edge[b]; }
+		/** last time of bin b < bins() */
+		time_t last(size_type b) const { return _edge[b + 1] - 1; }
+
+		bool operator== (const time_axis &other) const {
+			return _edge == other._edge;
+		}
+
+	private:
+		scale_type _scale;
+		time_t _width;
+		// start of each bin, then the range
+		std::vector<time_t> _edge;
+	};
+
+	/**
+	 * Cumulative count of events over binned time: the value of a bin
+	 * is the weight of every event recorded in it or before. Recording
+	 * an event is O(1) on a linear axis and a binary search on a log
+	 * one, the cumulative series is built with a single prefix sum when
+	 * it is reported. Events at or after the end of the range go to an
+	 * overflow bin, so they still count in the total. Counters are of
+	 * type Count, 32 bits halve the footprint of records that never
+	 * count more than 2^32 events.
+	 */
+	template <typename Count>
+	class basic_cmf {
+	public:
+		typedef Count count_type;
+		typedef unsigned long value_type;
+		typedef time_axis::size_type size_type;
+
+		basic_cmf(const time_axis &axis = time_axis()) :
+				_axis(axis), _count(axis.bins() + 1, 0) {};
+
+		/** record an event of weight w at time t */
+		void add(time_t t, count_type w = 1) {
+			_count[_axis.bin(t)] += w;
+		}
+
+		/** merge the events of another accumulator on the same axis */
+		basic_cmf& operator+= (const basic_cmf &other) {
+			for (size_type i = 0; i < _count.size(); ++i) {
+				_count[i] += other._count[i];
+			}
+			return *this;
+		}
+
+		/** drop every event */
+		void clear(void) { _count.assign(_count.size(), 0); }
+
+		const time_axis& axis(void) const { return _axis; }
+		/** bins within the range */
+		size_type bins(void) const { return _axis.bins(); }
+
+		/** the cumulative series, entry b sums the events up to bin b */
+		std::vector<value_type> cumulative(void) const {
+			std::vector<value_type> sum(bins());
+			value_type total = 0;
+			for (size_type i = 0; i < sum.size(); ++i) {
+				total += _count[i];
+				sum[i] = total;
+			}
+			return sum;
+		}
+
+		/**
+		 * @brief share of the total weight up to each bin, the
+		 * overflow included in the total: a series that falls short of
+		 * one at the end of the range shows the events past it.
+		 */
+		std::vector<double> distribution(void) const {
+			std::vector<value_type> sum = cumulative();
+			double all = total();
+			std::vector<double> share(sum.size());
+			for (size_type i = 0; i < sum.size(); ++i) {
+				share[i] = double(sum[i]) / all;
+			}
+			return share;
+		}
+
+		/** weight of the events at or after the end of the range */
+		value_type overflow(void) const { return _count.back(); }
+
+		/** weight of every event, the overflow included */
+		value_type total(void) const {
+			value_type total = 0;
+			for (count_type c : _count) {
+				total += c;
+			}
+			return total;
+		}
+
+	private:
+		time_axis _axis;
+		std::vector<count_type> _count;
+	};
+
+	typedef basic_cmf<unsigned long> cmf;
+	typedef basic_cmf<uint32_t> cmf32;
+
+}
+
+#endif
@@ -4,14 +4,19 @@
 #include <vector>
 #include <string>
 #include <random>
-#include <list>
+#include <cstdint>
+#include <utility>
 #include "common.h"
+#include "rng.h"
 
 #define RATELESS_TYPE 1
 #define MIN_TYPE 2
+#define RS_TYPE 3
 
 namespace strsim {
 
+	class encoding_pool;
+
 	class coded_block {
 	public:
 		/** Block type. */
@@ -21,19 +26,199 @@ namespace strsim {
 	};
 
 	class min_block : public coded_block {
+	public:
 		int virtual type(void) { return MIN_TYPE; };
 		virtual ~min_block() {};
 	};
 
+	/** A contiguous range of raw block indices */
+	template <typename T>
+	class index_span {
+	public:
+		typedef unsigned int size_type;
+		index_span(const T * first, const T * last) :
+			_first(first), _last(last) {};
+		const T * begin(void) const { return _first; }
+		const T * end(void) const { return _last; }
+		size_type size(void) const { return _last - _first; }
+		T operator[](size_type i) const { return _first[i]; }
+	private:
+		const T * _first;
+		const T * _last;
+	};
+
+	/**
+	 * Raw blocks covered by all coded blocks of one encoding, stored as
+	 * a flat array of indices plus the offset of each coded block in
+	 * that array. Indices take 16 bits when the number of raw blocks
+	 * allows it and 32 bits otherwise.
+	 */
+	class rateless_encoding {
+	public:
+		typedef unsigned int value_type;
+		typedef unsigned int size_type;
+		rateless_encoding() : _wide(false) { _offsets.push_back(0); };
+
+		/** drop all coded blocks and pick the index width for inum raw
+		 * blocks, memory is kept with room for encodings up to twice as
+		 * large as the last one so that it rarely has to grow again */
+		void reset(size_type inum) {
+			_wide = inum > 0x10000;
+			keep_headroom(_offsets);
+			keep_headroom(_narrow);
+			keep_headroom(_wide_index);
+			_offsets.resize(1);
+			_narrow.clear();
+			_wide_index.clear();
+		}
+
+		/** append a raw block to the coded block being built */
+		void push_raw(value_type raw) {
+			if (_wide) {
+				_wide_index.push_back(raw);
+			}else{
+				_narrow.push_back(raw);
+			}
+		}
+
+		/** close the coded block being built */
+		void close_block(void) {
+			_offsets.push_back(_wide ? _wide_index.size() : _narrow.size());
+		}
+
+		/** number of coded blocks */
+		size_type size(void) const { return _offsets.size() - 1; }
+
+		/** total number of raw block references over all blocks */
+		size_type num_edges(void) const { return _offsets.back(); }
+
+		/** number of raw blocks covered by the i-th coded block */
+		size_type degree(size_type i) const {
+			return _offsets[i+1] - _offsets[i];
+		}
+
+		bool wide(void) const { return _wide; }
+
+		/** raw blocks of the i-th coded block, only valid if !wide() */
+		index_span<uint16_t> narrow_span(size_type i) const {
+			return index_span<uint16_t>(_narrow.data() + _offsets[i],
+					_narrow.data() + _offsets[i+1]);
+		}
+
+		/** raw blocks of the i-th coded block, only valid if wide() */
+		index_span<uint32_t> wide_span(size_type i) const {
+			return index_span<uint32_t>(_wide_index.data() + _offsets[i],
+					_wide_index.data() + _offsets[i+1]);
+		}
+
+		/** call f on every raw block of the i-th coded block */
+		template <typename F>
+		void for_each(size_type i, F f) const {
+			if (_wide) {
+				for (uint32_t raw : wide_span(i)) {
+					f(raw);
+				}
+			}else{
+				for (uint16_t raw : narrow_span(i)) {
+					f(raw);
+				}
+			}
+		}
+
+	private:
+		template <typename T>
+		static void keep_headroom(std::vector<T> &v) {
+			if (v.capacity() < 2 * v.size()) {
+				v.reserve(4 * v.size());
+			}
+		}
+		bool _wide;
+		std::vector<uint32_t> _offsets;
+		std::vector<uint16_t> _narrow;
+		std::vector<uint32_t> _wide_index;
+	};
+
 	class rateless_block : public coded_block {	
 	public:
 		typedef unsigned int value_type;
 		typedef unsigned int size_type;
-		std::list<value_type> raw_blocks;
+		/** encoding holding the raw blocks of this block */
+		const rateless_encoding * encoding;
+		/** position of this block in the encoding */
+		size_type index;
+		/** coded data of this block, null if payloads are off */
+		uint8_t * payload;
+		rateless_block() : encoding(nullptr), index(0), payload(nullptr) {};
+		rateless_block(const rateless_encoding * e, size_type i) :
+			encoding(e), index(i), payload(nullptr) {};
+		size_type degree(void) const { return encoding->degree(index); }
+		/** call f on every raw block covered by this block */
+		template <typename F>
+		void for_each(F f) const { encoding->for_each(index, f); }
 		int inline virtual type(void) { return RATELESS_TYPE; }
 		virtual ~rateless_block() {};
 	};
 
+	class rs_block : public coded_block {
+	public:
+		typedef unsigned int size_type;
+		/** row of the generator matrix, rows below the number of raw
+		 * blocks are the raw blocks themselves */
+		size_type index;
+		/** coded data of this block, null if payloads are off */
+		uint8_t * payload;
+		rs_block() : index(0), payload(nullptr) {};
+		int inline virtual type(void) { return RS_TYPE; }
+		virtual ~rs_block() {};
+	};
+
+	/**
+	 * Caller-owned storage for the coded blocks of one encoding. The
+	 * arena is reused from trial to trial: blocks are only allocated
+	 * when an encoding needs more of them than any previous one, so a
+	 * steady-state trial does not touch the heap.
+	 */
+	class block_arena {
+	public:
+		typedef unsigned int size_type;
+		block_arena() {};
+		block_arena(const block_arena&) = delete;
+		block_arena& operator= (const block_arena&) = delete;
+
+		/** get at least n min blocks */
+		min_block * min_blocks(size_type n) {
+			if (_min.size() < n) {
+				_min.resize(n);
+			}
+			return _min.data();
+		}
+
+		/** get at least n rateless blocks */
+		rateless_block * rateless_blocks(size_type n) {
+			if (_rateless.size() < n) {
+				_rateless.resize(n);
+			}
+			return _rateless.data();
+		}
+
+		/** get at least n Reed-Solomon blocks */
+		rs_block * rs_blocks(size_type n) {
+			if (_rs.size() < n) {
+				_rs.resize(n);
+			}
+			return _rs.data();
+		}
+
+		/** raw blocks covered by the rateless blocks */
+		rateless_encoding encoding;
+		/** coded data of the blocks when payloads are on */
+		std::vector<uint8_t> payload;
+	private:
+		std::vector<min_block> _min;
+		std::vector<rateless_block> _rateless;
+		std::vector<rs_block> _rs;
+	};
+
 	/** Encode raw data to a set of @ref coded_block and reverse */
 	class coder {
 	public:
@@ -45,11 +230,14 @@ namespace strsim {
 		 *
 		 * @param[in] inum number of raw blocks
 		 * @param[in] onum number of coded blocks
-		 * @param[out] b a vector to hold the encoded blocks
+		 * @param[in] arena storage for the coded blocks
+		 * @param[out] b a vector refilled with the encoded blocks
 		 *
+		 * Blocks live in the arena so they are only valid until the
+		 * next call to encode with the same arena.
 		 */
 		void virtual encode(unsigned int inum, unsigned int onum,
-				std::vector<coded_block *> &b) = 0;
+				block_arena &arena, std::vector<coded_block *> &b) = 0;
 
 		/**
 		 * @brief reconstruct the original data by adding a new coded block
@@ -76,90 +264,436 @@ namespace strsim {
 		 * this block from coded blocks */
 		void virtual feed(int /* index */) = 0;
 
+		/**
+		 * Turn payload mode on with blocks of block_size bytes, or off
+		 * with 0. Coded blocks then carry real data that the decoder
+		 * uses to restore the raw data, see @ref encode_payload and
+		 * @ref data. Coders that only count blocks ignore it.
+		 */
+		void virtual payload(size_type /* block_size */) {}
+
+		/** restart the random choices of encode from a stream of a
+		 * key, coders that encode deterministically ignore it */
+		void virtual seed(uint64_t /* key */, uint64_t /* stream */) {}
+
+		/**
+		 * @brief compute the data of the coded blocks of the last
+		 * encoding into the arena
+		 *
+		 * @param[in] raw data of the raw blocks, back to back
+		 * @param[in,out] arena arena used by the last call to encode
+		 */
+		void virtual encode_payload(const uint8_t * /* raw */,
+				block_arena & /* arena */) {}
+
+		/** data of the raw blocks restored so far, back to back, or
+		 * null if the coder does not restore data. In payload mode,
+		 * the data of a raw block must be written here before feeding
+		 * it to the decoder. */
+		uint8_t virtual * data(void) { return nullptr; }
+
+		virtual ~coder() {}
 	};
 
 	class degree_generator : public rnd_generator {
 	public:
 		void virtual setup(value_type seed) = 0;
+		/** restart the random sequence from a stream of a key */
+		void virtual seed(uint64_t key, uint64_t stream) = 0;
+		/** name of the distribution and its parameters */
+		std::string virtual name(void) const = 0;
 		virtual ~degree_generator() {}
 	};
 
-	class soliton_generator : public degree_generator {
+	/**
+	 * Walker/Vose alias table, samples a value from a discrete
+	 * distribution over 1..size in constant time
+	 */
+	class alias_table {
+	public:
+		typedef unsigned int value_type;
+		typedef unsigned int size_type;
+		/** build the table, weights[i] is the (not necessarily
+		 * normalized) weight of value i + 1 */
+		void build(const std::vector<double> &weights);
+		/** map a uniform number in [0, 1) to a value */
+		value_type inline sample(double u) const {
+			double x = u * _prob.size();
+			size_type i = x;
+			if (i >= _prob.size()) {
+				// u * size may round up to size
+				i = _prob.size() - 1;
+			}
+			return (x - i < _prob[i]) ? i + 1 : _alias[i] + 1;
+		}
+		size_type size(void) const { return _prob.size(); }
 	private:
+		// probability of keeping column i rather than its alias
+		std::vector<double> _prob;
+		std::vector<value_type> _alias;
+		// work lists used while building the table
+		std::vector<size_type> _small;
+		std::vector<size_type> _large;
+	};
+
+	/**
+	 * Draws d distinct values out of 0..n-1, every subset equally
+	 * likely, in O(d) whatever d: a partial Fisher-Yates shuffle of a
+	 * table of 0..n-1 whose swaps are logged and undone afterwards, so
+	 * the table is back in order for the next draw without a pass over
+	 * all of it.
+	 */
+	class subset_sampler {
+	public:
+		typedef unsigned int value_type;
+		typedef unsigned int size_type;
+		/** draw from 0..n-1 from now on */
+		void reset(size_type n) {
+			if (_table.size() != n) {
+				_table.resize(n);
+				for (size_type i = 0; i < n; ++i) {
+					_table[i] = i;
+				}
+			}
+			_swap.reserve(n);
+		}
+		/** call f on each of d <= n distinct values, in random order */
+		template <typename RNG, typename F>
+		void sample(size_type d, RNG &rng, F f) {
+			typedef std::uniform_int_distribution<size_type> uniform;
+			uniform dist;
+			size_type last = _table.size() - 1;
+			_swap.clear();
+			for (size_type i = 0; i < d; ++i) {
+				size_type j = dist(rng, uniform::param_type(i, last));
+				std::swap(_table[i], _table[j]);
+				_swap.push_back(j);
+				f(_table[i]);
+			}
+			for (size_type i = d; i-- > 0; ) {
+				std::swap(_table[i], _table[_swap[i]]);
+			}
+		}
+		size_type size(void) const { return _table.size(); }
+	private:
+		std::vector<value_type> _table;
+		// position each value was swapped in from
+		std::vector<size_type> _swap;
+	};
+
+	/** Ideal soliton distribution over 1..k */
+	class soliton_generator : public degree_generator {
+	protected:
 		// use uniform distribution for random generation
-		std::mt19937 _gen;
+		philox _gen;
 		std::uniform_real_distribution<double> _dist;
-		double * _cdf; // table for cdf
+		alias_table _table;
+		std::vector<double> _weights;
 		value_type _size;
+		/** fill w with the weight of each degree for k raw blocks */
+		void virtual weights(value_type k, std::vector<double> &w);
 	public:
-		soliton_generator() : _gen(std::random_device()()),
-				_dist(0, 1), _cdf(nullptr), _size(0) {};
+		soliton_generator() : _gen(global_seed(), next_stream()),
+				_dist(0, 1), _size(0) {};
 		soliton_generator(value_type seed) : soliton_generator() {
 			setup(seed);
 		}
-		~soliton_generator() { if (_cdf != nullptr) { delete[] _cdf; } };
-		/** Setup the generator, must be called before sampling */
+		virtual ~soliton_generator() {};
+		/** Setup the generator for seed raw blocks, must be called
+		 * before sampling */
 		void setup(value_type seed);
+		void seed(uint64_t key, uint64_t stream) {
+			_gen.seed(key, stream);
+			_dist.reset();
+		}
 		/** Sampling from the generator */
-		value_type sample();
+		value_type sample() { return _table.sample(_dist(_gen)); }
+		std::string virtual name(void) const { return "soliton"; }
+	};
+
+	/**
+	 * Robust soliton distribution over 1..k (Luby), the ideal soliton
+	 * plus extra low degrees and a spike at k/R, where
+	 * R = c * ln(k / delta) * sqrt(k)
+	 */
+	class robust_soliton_generator : public soliton_generator {
+	protected:
+		double _c;
+		double _delta;
+		void virtual weights(value_type k, std::vector<double> &w);
+	public:
+		robust_soliton_generator(double c, double delta) :
+			_c(c), _delta(delta) {};
+		robust_soliton_generator(double c, double delta, value_type seed) :
+				robust_soliton_generator(c, delta) {
+			setup(seed);
+		}
+		std::string virtual name(void) const;
 	};
 
 	class uniform_generator : public degree_generator {
 	private:
-		std::mt19937 _gen;
+		philox _gen;
 		std::uniform_real_distribution<double> _dist;
 		value_type _range;
 	public:
-		uniform_generator() : _gen(std::random_device()()), _dist(0, 1) {};
+		uniform_generator() : _gen(global_seed(), next_stream()),
+				_dist(0, 1) {};
 		uniform_generator(value_type seed) : uniform_generator() {
 			setup(seed);
 		}
 		void setup(value_type seed);
+		void seed(uint64_t key, uint64_t stream) {
+			_gen.seed(key, stream);
+			_dist.reset();
+		}
 		value_type sample();
+		std::string virtual name(void) const { return "uniform"; }
 	};
 
 
+	/**
+	 * Linearly independent rows of a matrix over GF(2) kept in echelon
+	 * form, 64 columns packed per word. Rows are added one at a time,
+	 * so rank() tells when the rows received so far have full rank.
+	 * Each row may carry a payload of bytes that follows the row
+	 * operations, so that a full rank system can be solved.
+	 */
+	class gf2_basis {
+	public:
+		typedef uint64_t word_type;
+		typedef unsigned int size_type;
+		static const size_type NO_ROW = ~size_type(0);
+		gf2_basis() : _columns(0), _words(0), _rank(0), _size(0) {};
+		/** drop all rows and start over with the given columns and
+		 * payload size in bytes */
+		void reset(size_type columns, size_t payload = 0);
+		/** zeroed buffer to build the next row in */
+		word_type * row(void);
+		/** payload of the row being built, set by row() to zero */
+		uint8_t * payload(void) { return _payload_scratch.data(); }
+		/** set a column of the row being built */
+		void inline set(word_type * row, size_type column) {
+			row[column / 64] ^= word_type(1) << (column % 64);
+		}
+		/**
+		 * reduce the row built in row() by the rows already kept
+		 *
+		 * @return true if the row is independent and increased the rank
+		 */
+		bool insert(void);
+		size_type rank(void) const { return _rank; }
+		size_type columns(void) const { return _columns; }
+		size_type words(void) const { return _words; }
+		/**
+		 * back substitute a full rank system
+		 *
+		 * @param[out] out payload of every column, back to back
+		 */
+		void solve(uint8_t * out) const;
+	private:
+		size_type _columns;
+		size_type _words;
+		size_type _rank;
+		size_t _size;
+		// kept rows, _rank rows of _words words each, and their payloads
+		std::vector<word_type> _rows;
+		std::vector<uint8_t> _payloads;
+		std::vector<uint8_t> _payload_scratch;
+		// row whose lowest set column is the given column
+		std::vector<size_type> _pivot;
+		std::vector<word_type> _scratch;
+	};
+
 	class rateless_coder : public coder {
 	protected:
-		std::list<value_type> _raw_queue;
-		std::list<std::list<value_type>> _coding_queue;
 		std::vector<value_type> _raw_table;
 		size_type _num_blocks;
+		size_type _num_coded;
+		size_type _num_recovered;
+		// residual degree and xor of the unrecovered raw blocks of every
+		// coded block still waiting for decoding, a degree of 0 means
+		// the block is no longer useful
+		std::vector<size_type> _degree;
+		std::vector<value_type> _residual;
+		// coded blocks waiting for each raw block (inverted index), kept
+		// as linked lists threaded through flat arrays: _head gives the
+		// first edge of a raw block, _edge_block and _edge_next give the
+		// coded block and the next edge of every edge
+		std::vector<size_type> _head;
+		std::vector<size_type> _edge_block;
+		std::vector<size_type> _edge_next;
+		// raw blocks recovered but not yet used to reduce coded blocks
+		std::vector<value_type> _ripple;
 		degree_generator * _gen;
+		philox _rng;
+		// raw blocks of each coded block
+		subset_sampler _subset;
+		// verified encodings to draw from instead of encoding, and the
+		// raw block each raw block of the pool is relabelled to
+		const encoding_pool * _pool;
+		std::vector<value_type> _label;
+		// inactivation decoding: once there are as many waiting coded
+		// blocks as missing raw blocks, the missing raw blocks are
+		// peeled symbolically, inactivating some of them whenever
+		// peeling gets stuck. Every other missing raw block is then an
+		// expression over the inactive ones, and the blocks that were
+		// not used for peeling, plus every block received since, are
+		// rows of a small GF(2) system over the inactive raw blocks.
+		enum { KNOWN, ACTIVE, SOLVED, INACTIVE };
+		bool _inactivation;
+		bool _eliminating;
+		size_type _num_pending;
+		std::vector<const rateless_block *> _pending;
+		// state of each raw block when elimination started, and its
+		// inactive column or the position of its expression
+		std::vector<unsigned char> _state;
+		std::vector<size_type> _slot;
+		// residual degree and xor of the active raw blocks of every
+		// waiting coded block during symbolic peeling
+		std::vector<size_type> _active_degree;
+		std::vector<value_type> _active_residual;
+		std::vector<size_type> _stack;
+		std::vector<unsigned char> _used;
+		// raw blocks in the order they were solved, inactive raw blocks
+		// and the expression of every solved raw block
+		std::vector<value_type> _order;
+		std::vector<value_type> _inactive;
+		std::vector<gf2_basis::word_type> _expr;
+		// coded block each solved raw block was peeled from
+		std::vector<size_type> _peeled;
+		// raw blocks peeled since elimination started
+		std::vector<value_type> _solved;
+		gf2_basis _basis;
+		// payload mode: raw data restored so far, data of the waiting
+		// coded blocks reduced by the raw blocks recovered since they
+		// arrived, and the constant part of every solved expression
+		size_type _block_size;
+		std::vector<uint8_t> _data;
+		std::vector<uint8_t> _work;
+		std::vector<uint8_t> _expr_payload;
+		/** mark a raw block as recovered and put it on the ripple */
+		void recover(value_type raw);
+		/** reduce waiting coded blocks until the ripple runs out */
+		void propagate(void);
+		/** take a missing raw block out of symbolic peeling */
+		void deactivate(value_type raw);
+		/** start elimination over the raw blocks still missing, with
+		 * payloads if the system is going to be solved */
+		void start_elimination(bool payload);
+		/** add a missing raw block to a row of the inactive system, and
+		 * its constant to the payload of the row if there is one */
+		void add_column(gf2_basis::word_type * row, uint8_t * payload,
+				value_type raw);
+		/** restore the data of every missing raw block once the
+		 * received blocks have full rank */
+		void solve_payload(void);
+		uint8_t * work(size_type id) {
+			return _work.data() + size_t(id) * _block_size;
+		}
+		/** room for the data of every coded block of the encoding, the
+		 * buffer only grows so that trials reuse it */
+		void size_work(void) {
+			if (_work.size() < size_t(_num_coded) * _block_size) {
+				_work.resize(size_t(_num_coded) * _block_size);
+			}
+		}
+		/** add the missing raw blocks of a coded block as a row */
+		void insert_row(const rateless_block * block);
+		/** bring the elimination up to date after receiving a block,
+		 * or after feeding a raw block if block is null */
+		void eliminate(const rateless_block * block);
 	public:
-		rateless_coder() : _gen(new uniform_generator()) {};
+		/** marks the end of an edge list */
+		static const size_type NO_EDGE = ~size_type(0);
+		rateless_coder() : _num_blocks(0), _num_coded(0), _num_recovered(0),
+				_gen(new uniform_generator()),
+				_rng(global_seed(), next_stream()), _pool(nullptr),
+				_inactivation(false),
+				_eliminating(false), _num_pending(0), _block_size(0) {};
 		~rateless_coder() { delete _gen; };
 		int type(void) { return RATELESS_TYPE; }
+		/** the degree generator gets the stream with the top bit set */
+		void seed(uint64_t key, uint64_t stream) {
+			_rng.seed(key, stream);
+			_gen->seed(key, stream | (uint64_t(1) << 63));
+		}
 		void encode(unsigned int inum, unsigned int onum,
-				std::vector<coded_block *> &b);
+				block_arena &arena, std::vector<coded_block *> &b);
 		unsigned int decode(coded_block * b);
+
+		/** name of the degree distribution */
+		std::string degree(void) const { return _gen->name(); }
+
+		/**
+		 * Draw encodings from a pool of verified ones, or encode every
+		 * time with null. An encoding of the size of the pool is one of
+		 * its encodings picked at random with the raw blocks randomly
+		 * relabelled, other sizes are still encoded. The pool must
+		 * outlive its use and be of the same degree distribution.
+		 */
+		void pool(const encoding_pool * p) { _pool = p; }
 		
 		void virtual restart(void) {
 			for (size_type i = 0; i < _num_blocks; ++i) {
 				_raw_table[i] = false;
+				_head[i] = NO_EDGE;
 			}
-			_raw_queue.clear();
-			_coding_queue.clear();
+			_num_recovered = 0;
+			_degree.clear();
+			_residual.clear();
+			_edge_block.clear();
+			_edge_next.clear();
+			_ripple.clear();
+			_eliminating = false;
+			_num_pending = 0;
+			_pending.clear();
+			_solved.clear();
+			size_work();
 		}
 
+		/**
+		 * Turn inactivation decoding on or off. When peeling stalls,
+		 * the decoder falls back to Gaussian elimination on the blocks
+		 * it is waiting on and finishes as soon as the received blocks
+		 * have full rank, instead of waiting for more blocks to peel.
+		 * Until then, decode() only counts raw blocks restored by
+		 * peeling.
+		 */
+		void inactivation(bool on) { _inactivation = on; }
+
+		/** in payload mode the decoder xors coded data while it peels */
+		void virtual payload(size_type block_size) {
+			_block_size = block_size;
+		}
+		void virtual encode_payload(const uint8_t * raw, block_arena &arena);
+		uint8_t virtual * data(void) { return _data.data(); }
+
 		bool virtual inline has_finished(void) {
-			return _num_blocks == _raw_queue.size();
+			return _num_blocks == _num_recovered;
 		}
 
 		void virtual feed(int index) {
 			if (!_raw_table[index]) {
-				_raw_queue.push_back(index);
-				_raw_table[index] = true;
+				recover(index);
+				propagate();
+				eliminate(nullptr);
 			}
 		};
 	};
 
 	class luby_coder : public rateless_coder {
 	public:
+		/** LT code with the ideal soliton distribution */
 		luby_coder() {
 			delete _gen;
 			_gen = new soliton_generator();
 		};
+		/** LT code with the robust soliton distribution */
+		luby_coder(double c, double delta) {
+			delete _gen;
+			_gen = new robust_soliton_generator(c, delta);
+		};
 	};
 
 	class min_coder : public coder {
@@ -170,10 +704,10 @@ namespace strsim {
 		void virtual restart(void) {
 			_block_left = _num_blocks;
 		}
-		min_coder() {};
+		min_coder() : _num_blocks(0), _block_left(0) {};
 		int type(void) { return MIN_TYPE; }
 		void encode(unsigned int inum, unsigned int onum,
-				std::vector<coded_block *> &b);
+				block_arena &arena, std::vector<coded_block *> &b);
 		unsigned int decode(coded_block * b);
 		bool virtual inline has_finished(void) {
 			return (_block_left == 0);
@@ -185,6 +719,58 @@ namespace strsim {
 		};
 
 	};
+
+	/**
+	 * Systematic Reed-Solomon code over GF(2^8). The first inum coded
+	 * blocks are the raw blocks and the others are parities built from
+	 * a Cauchy matrix, so any inum distinct coded blocks restore the
+	 * data. At most 256 coded blocks fit in the field.
+	 */
+	class rs_coder : public coder {
+	private:
+		size_type _num_blocks;
+		size_type _num_coded;
+		size_type _block_size;
+		// (onum - inum) x inum parity rows
+		std::vector<uint8_t> _cauchy;
+		// rows received so far and where their data is
+		std::vector<bool> _have;
+		std::vector<size_type> _rows;
+		std::vector<const uint8_t *> _sources;
+		std::vector<uint8_t> _data;
+		// decoding scratch: the square system of the missing raw
+		// blocks, its inverse and the parity data left to solve
+		std::vector<uint8_t> _matrix;
+		std::vector<uint8_t> _inverse;
+		std::vector<uint8_t> _rhs;
+		/** add a row to the received ones */
+		void receive(size_type row, const uint8_t * source);
+		/** restore the missing raw data from the received rows */
+		void solve(void);
+	public:
+		/** number of coded blocks GF(2^8) can hold */
+		static const size_type MAX_BLOCKS = 256;
+		rs_coder() : _num_blocks(0), _num_coded(0), _block_size(0) {};
+		int type(void) { return RS_TYPE; }
+		void encode(unsigned int inum, unsigned int onum,
+				block_arena &arena, std::vector<coded_block *> &b);
+		unsigned int decode(coded_block * b);
+		void virtual restart(void) {
+			_have.assign(_num_coded, false);
+			_rows.clear();
+			_sources.clear();
+		}
+		bool virtual inline has_finished(void) {
+			return _rows.size() >= _num_blocks;
+		}
+		void virtual feed(int index);
+		/** in payload mode the decoder inverts the received rows */
+		void virtual payload(size_type block_size) {
+			_block_size = block_size;
+		}
+		void virtual encode_payload(const uint8_t * raw, block_arena &arena);
+		uint8_t virtual * data(void) { return _data.data(); }
+	};
 	
 	
 }
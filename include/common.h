@@ -11,12 +11,27 @@
 
 #endif
 
+#include <cstddef>
+#include <limits>
+
 namespace strsim {
 	class rnd_generator {
 	public:
 		typedef unsigned int value_type;
 		/** Sampling from the generator */
 		value_type virtual sample(void) = 0;
+		/** Fill out with count samples. Generators that can draw a
+		 * whole batch at once, with vector math, override it. */
+		void virtual sample_batch(value_type * out, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				out[i] = sample();
+			}
+		}
+		/** Chance that a sample is at most v, for the generators with
+		 * a known distribution, nan for the others */
+		double virtual cdf(value_type v) const {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
 	};
 
 }
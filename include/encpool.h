@@ -0,0 +1,134 @@
+#ifndef ENCPOOL_H
+#define ENCPOOL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "code.h"
+#include "pool.h"
+
+namespace strsim {
+
+	/**
+	 * Rateless encodings of k raw blocks into n coded blocks that are
+	 * known to decode, built once and kept in a file that later runs
+	 * map read-only. A trial copies one of them with the raw blocks
+	 * relabelled at random instead of encoding and checking a new one,
+	 * which costs a pass over the edges. A file holds the encodings of
+	 * one (k, n, degree distribution, seed), in this layout:
+	 *
+	 * - the header, see @ref encoding_pool::header
+	 * - the first edge of each encoding and the total, count + 1
+	 * 64-bit offsets into the edges
+	 * - for each encoding, the first edge of each coded block relative
+	 * to the encoding and the edges of the encoding, n + 1 32-bit
+	 * offsets
+	 * - the raw block of every edge, 16 bits for k <= 65536 and 32
+	 * bits otherwise
+	 */
+	class encoding_pool {
+	public:
+		typedef rateless_encoding::value_type value_type;
+		typedef rateless_encoding::size_type size_type;
+		/** new coder of the code the pool is built for */
+		typedef std::function<rateless_coder*()> coder_factory;
+
+		// 2 since raw blocks are drawn without the clustering of
+		// linear probing
+		static const uint32_t VERSION = 2;
+		struct header {
+			char magic[8];
+			uint32_t version;
+			uint32_t inum;
+			uint32_t onum;
+			uint32_t count;
+			uint64_t seed;
+			uint64_t edges;
+			// degree distribution, see degree_generator::name
+			char degree[64];
+		};
+
+		encoding_pool() : _map(nullptr), _length(0), _header(nullptr),
+			_start(nullptr), _offset(nullptr), _edge(nullptr) {}
+		encoding_pool(const encoding_pool&) = delete;
+		encoding_pool& operator= (const encoding_pool&) = delete;
+		~encoding_pool() { close(); }
+
+		/**
+		 * @brief map a pool file, false if there is none or if it holds
+		 * encodings of other parameters
+		 */
+		bool open(const std::string &path, size_type inum, size_type onum,
+				const std::string &degree, uint64_t seed);
+
+		/**
+		 * @brief encode count times with coders of make, on the
+		 * workers of pool and encoding i from its own stream of seed,
+		 * write the encodings to path and map them. The file only
+		 * depends on the parameters, not on the number of workers.
+		 * False if the file cannot be written.
+		 */
+		bool build(const std::string &path, const coder_factory &make,
+				size_type inum, size_type onum, size_type count,
+				uint64_t seed, task_pool &pool);
+
+		/** unmap the file */
+		void close(void);
+
+		bool is_open(void) const { return _header != nullptr; }
+		/** encodings in the pool */
+		size_type size(void) const { return is_open() ? _header->count : 0; }
+		size_type inum(void) const { return _header->inum; }
+		size_type onum(void) const { return _header->onum; }
+
+		/** whether the pool holds encodings of inum into onum blocks */
+		bool matches(size_type inum, size_type onum) const {
+			return size() > 0 && _header->inum == inum &&
+				_header->onum == onum;
+		}
+
+		/** copy encoding e into out, raw block r of the pool becoming
+		 * raw block label[r] */
+		void draw(size_type e, const value_type * label,
+				rateless_encoding &out) const {
+			out.reset(_header->inum);
+			const uint32_t * offset = _offset +
+				size_t(e) * (_header->onum + 1);
+			uint64_t first = _start[e];
+			for (size_type i = 0; i < _header->onum; ++i) {
+				if (_header->inum > 0x10000) {
+					const uint32_t * edge =
+						static_cast<const uint32_t *>(_edge) + first;
+					for (uint32_t j = offset[i]; j < offset[i + 1]; ++j) {
+						out.push_raw(label[edge[j]]);
+					}
+				} else {
+					const uint16_t * edge =
+						static_cast<const uint16_t *>(_edge) + first;
+					for (uint32_t j = offset[i]; j < offset[i + 1]; ++j) {
+						out.push_raw(label[edge[j]]);
+					}
+				}
+				out.close_block();
+			}
+		}
+
+		/** name of the pool file of a code in a directory */
+		static std::string file_name(const std::string &dir,
+				size_type inum, size_type onum, const std::string &degree,
+				uint64_t seed);
+
+	private:
+		void * _map;
+		size_t _length;
+		const header * _header;
+		const uint64_t * _start;
+		const uint32_t * _offset;
+		const void * _edge;
+	};
+
+}
+
+#endif
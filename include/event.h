@@ -0,0 +1,354 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+
+namespace strsim {
+
+	/**
+	 * Calendar queue: a min-priority queue over integer keys that never
+	 * go below the last key popped, as the times of a simulation. A ring
+	 * of 2^bits one-unit buckets covers the keys from the last one
+	 * popped on, an item goes to the bucket of its key and keys further
+	 * ahead wait in an overflow list until the ring reaches them. A
+	 * bitmap of the non-empty buckets, with a summary bit per word of
+	 * it, finds the next key in a few word scans, so push and pop cost
+	 * O(1) whatever the spread of the keys within the ring. Items of
+	 * equal keys come out in the order they were pushed. Buckets are
+	 * lists linked through one pool of items, which only grows past the
+	 * most items ever held at once.
+	 */
+	template <typename T>
+	class calendar_queue {
+	public:
+		typedef uint64_t key_type;
+		typedef size_t size_type;
+
+		/** ring of 2^bits buckets, bits at least 12 */
+		explicit calendar_queue(unsigned int bits = 14) :
+				_mask((size_t(1) << bits) - 1), _bucket(_mask + 1),
+				_word((_mask + 1) / 64, 0), _summary((_mask + 1) / 4096, 0),
+				_last(0), _free(NIL), _near(0), _far_min(FAR),
+				_size(0) {}
+
+		/** add value with a key no smaller than the last one popped */
+		void push(key_type key, const T &value) {
+			uint32_t i = _free;
+			if (i != NIL) {
+				_free = _item[i].next;
+			} else {
+				i = _item.size();
+				_item.push_back(item());
+			}
+			_item[i].key = key;
+			_item[i].value = value;
+			if (key - _last <= _mask) {
+				append_near(i);
+			} else {
+				append(_far, i);
+				_far_min = std::min(_far_min, key);
+			}
+			_size++;
+		}
+
+		bool empty(void) const { return _size == 0; }
+		size_type size(void) const { return _size; }
+		/** keys a pushed item may be ahead of the last one popped
+		 * without going to the overflow list */
+		size_type span(void) const { return _mask + 1; }
+
+		/** smallest key, the queue is not empty */
+		key_type top_key(void) {
+			settle();
+			return _last;
+		}
+
+		/** value of the smallest key, the queue is not empty */
+		const T& top(void) {
+			settle();
+			return _item[_bucket[_last & _mask].head].value;
+		}
+
+		/** drop the value of the smallest key */
+		void pop(void) {
+			settle();
+			size_t b = _last & _mask;
+			uint32_t i = _bucket[b].head;
+			_bucket[b].head = _item[i].next;
+			if (_bucket[b].head == NIL) {
+				mark(b, false);
+			}
+			_item[i].next = _free;
+			_free = i;
+			_near--;
+			_size--;
+		}
+
+		/** drop every value, keys start over from start */
+		void clear(key_type start = 0) {
+			// only the non-empty buckets need resetting
+			for (size_t s = 0; s < _summary.size(); ++s) {
+				for (; _summary[s] != 0; _summary[s] &= _summary[s] - 1) {
+					size_t w = (s << 6) | __builtin_ctzll(_summary[s]);
+					for (; _word[w] != 0; _word[w] &= _word[w] - 1) {
+						_bucket[(w << 6) |
+							__builtin_ctzll(_word[w])].head = NIL;
+					}
+				}
+			}
+			_far.head = NIL;
+			_item.clear();
+			_last = start;
+			_free = NIL;
+			_near = 0;
+			_far_min = FAR;
+			_size = 0;
+		}
+
+	private:
+		static const uint32_t NIL = ~uint32_t(0);
+		static const key_type FAR = ~key_type(0);
+		struct item {
+			key_type key;
+			T value;
+			uint32_t next;
+		};
+		struct list {
+			uint32_t head;
+			uint32_t tail;
+			list() : head(NIL), tail(NIL) {}
+		};
+		const size_t _mask;
+		std::vector<item> _item;
+		std::vector<list> _bucket;
+		// bit b of the words is set when bucket b is not empty, bit w of
+		// the summary when word w is not 0
+		std::vector<uint64_t> _word;
+		std::vector<uint64_t> _summary;
+		list _far;
+		key_type _last;
+		// unused items of the pool
+		uint32_t _free;
+		// items in the ring, and the smallest key of the overflow list
+		size_type _near;
+		key_type _far_min;
+		size_type _size;
+
+		void append(list &l, uint32_t i) {
+			_item[i].next = NIL;
+			if (l.head == NIL) {
+				l.head = i;
+			} else {
+				_item[l.tail].next = i;
+			}
+			l.tail = i;
+		}
+
+		void append_near(uint32_t i) {
+			size_t b = _item[i].key & _mask;
+			if (_bucket[b].head == NIL) {
+				mark(b, true);
+			}
+			append(_bucket[b], i);
+			_near++;
+		}
+
+		void mark(size_t b, bool busy) {
+			size_t w = b >> 6;
+			if (busy) {
+				_word[w] |= uint64_t(1) << (b & 63);
+				_summary[w >> 6] |= uint64_t(1) << (w & 63);
+				return;
+			}
+			_word[w] &= ~(uint64_t(1) << (b & 63));
+			if (_word[w] == 0) {
+				_summary[w >> 6] &= ~(uint64_t(1) << (w & 63));
+			}
+		}
+
+		/* first non-empty word from w on, the number of words if none */
+		size_t next_word(size_t w) const {
+			if (w >= _word.size()) {
+				return _word.size();
+			}
+			size_t s = w >> 6;
+			uint64_t bits = _summary[s] & (~uint64_t(0) << (w & 63));
+			while (bits == 0) {
+				if (++s == _summary.size()) {
+					return _word.size();
+				}
+				bits = _summary[s];
+			}
+			return (s << 6) | __builtin_ctzll(bits);
+		}
+
+		/* first non-empty bucket from b on around the ring, which is
+		 * not empty */
+		size_t next_bucket(size_t b) const {
+			size_t w = b >> 6;
+			uint64_t bits = _word[w] & (~uint64_t(0) << (b & 63));
+			if (bits != 0) {
+				return (w << 6) | __builtin_ctzll(bits);
+			}
+			w = next_word(w + 1);
+			if (w == _word.size()) {
+				w = next_word(0);
+			}
+			return (w << 6) | __builtin_ctzll(_word[w]);
+		}
+
+		/* move the smallest key to _last and its items to their bucket.
+		 * Overflow items enter the ring as soon as it covers them, so
+		 * they come before any item of the same key pushed later. */
+		void settle(void) {
+			if (_bucket[_last & _mask].head != NIL) {
+				return;
+			}
+			key_type next = _far_min;
+			if (_near > 0) {
+				size_t b = next_bucket(_last & _mask);
+				next = std::min(next, _last + ((b - _last) & _mask));
+			}
+			_last = next;
+			if (_far_min - _last > _mask) {
+				return;
+			}
+			uint32_t i = _far.head;
+			_far.head = NIL;
+			_far_min = FAR;
+			while (i != NIL) {
+				uint32_t after = _item[i].next;
+				if (_item[i].key - _last <= _mask) {
+					append_near(i);
+				} else {
+					append(_far, i);
+					_far_min = std::min(_far_min, _item[i].key);
+				}
+				i = after;
+			}
+		}
+	};
+
+	/**
+	 * Discrete-event core of the policy simulators. Events are small
+	 * values on a @ref calendar_queue keyed by their time. A run hands
+	 * each one to the member of a handler for its type, called directly
+	 * rather than through a function object, which may schedule later
+	 * events or stop the run. Events of the same time are handled in the
+	 * order they were scheduled, an event dispatched by a handler is
+	 * handled at once. The engine is reset between trials and reuses its
+	 * storage, a trial only allocates to hold more events at once than
+	 * any trial before.
+	 */
+	class event_engine {
+	public:
+		enum event_type { ISSUE, ARRIVE, PROGRESS, CANCEL };
+
+		struct event {
+			time_t time;
+			event_type type;
+			// block or request the event is about, and a value of
+			// the handler's choice (blocks left, cache size, ...)
+			uint32_t id;
+			uint32_t value;
+		};
+
+		/** times are usually less than 2^bits ahead of now() */
+		explicit event_engine(unsigned int bits = 14) : _queue(bits),
+			_now(0), _stopped(false) {}
+
+		/** schedule an event at time no earlier than now() */
+		void schedule(time_t time, event_type type, uint32_t id,
+				uint32_t value = 0) {
+			entry e = {type, id, value};
+			_queue.push(time, e);
+		}
+
+		/** handle an event at now() with handler right away, before the
+		 * scheduled ones of the same time */
+		template <typename H>
+		void dispatch(H &handler, event_type type, uint32_t id,
+				uint32_t value = 0) {
+			event e = {_now, type, id, value};
+			deliver(handler, e);
+		}
+
+		/** handle events in time order with handler until none is left
+		 * or it calls stop() */
+		template <typename H>
+		void run(H &handler) {
+			_stopped = false;
+			while (!_stopped && !_queue.empty()) {
+				const entry &top = _queue.top();
+				event e = {time_t(_queue.top_key()), top.type, top.id,
+					top.value};
+				_queue.pop();
+				_now = e.time;
+				deliver(handler, e);
+			}
+		}
+
+		/** end the run after the event being handled */
+		void stop(void) { _stopped = true; }
+		/** whether a handler ended the run */
+		bool stopped(void) const { return _stopped; }
+
+		/** drop the pending events and go back to time 0 */
+		void reset(void) {
+			_queue.clear();
+			_now = 0;
+		}
+
+		/** time of the event being handled */
+		time_t now(void) const { return _now; }
+		/** events scheduled and not handled yet */
+		size_t pending(void) const { return _queue.size(); }
+
+	private:
+		// an event without its time, the key of the queue
+		struct entry {
+			event_type type;
+			uint32_t id;
+			uint32_t value;
+		};
+		calendar_queue<entry> _queue;
+		time_t _now;
+		bool _stopped;
+
+		template <typename H>
+		static void deliver(H &handler, const event &e) {
+			switch (e.type) {
+			case ISSUE:
+				handler.issue(e);
+				break;
+			case ARRIVE:
+				handler.arrive(e);
+				break;
+			case PROGRESS:
+				handler.progress(e);
+				break;
+			case CANCEL:
+				handler.cancel(e);
+				break;
+			}
+		}
+	};
+
+	/**
+	 * Handler of @ref event_engine that ignores every event. Handlers
+	 * derive from it and hide the members of the types they handle.
+	 */
+	struct event_handler {
+		typedef event_engine::event event;
+		void issue(const event &) {}
+		void arrive(const event &) {}
+		void progress(const event &) {}
+		void cancel(const event &) {}
+	};
+
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef KOFN_H
+#define KOFN_H
+
+#include <vector>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include "common.h"
+
+namespace strsim {
+
+	/**
+	 * One trial of a k-of-n (MDS) load without coded blocks. With
+	 * @ref min_coder the data is back once any k blocks arrived, so a
+	 * trial only needs the order statistics of the n arrival times.
+	 * They are drawn into a buffer reused from trial to trial and read
+	 * off with selection instead of a full sort.
+	 */
+	class kofn_trial {
+	public:
+		typedef unsigned int size_type;
+
+		/** start a new trial */
+		void clear(void) { _times.clear(); }
+
+		/** draw the arrival time of n more blocks in one batch */
+		void sample(size_type n, rnd_generator &gen) {
+			_draw.resize(n);
+			gen.sample_batch(_draw.data(), n);
+			_times.insert(_times.end(), _draw.begin(), _draw.end());
+		}
+
+		/** arrival times, only the selected ones are in place */
+		const std::vector<time_t>& times(void) const { return _times; }
+		size_type size(void) const { return _times.size(); }
+
+		/**
+		 * @brief arrival of the m-th earliest block among the first
+		 * `within` times (all of them by default). Afterwards, the
+		 * first m times are the m earliest ones in no particular order.
+		 */
+		time_t select(size_type m, size_type within = 0) {
+			if (within == 0) {
+				within = _times.size();
+			}
+			std::nth_element(_times.begin(), _times.begin() + m - 1,
+					_times.begin() + within);
+			return _times[m - 1];
+		}
+
+		/** sort the m earliest arrival times into the first m places */
+		void order(size_type m) {
+			if (m == 0) {
+				return;
+			}
+			select(m);
+			std::sort(_times.begin(), _times.begin() + m);
+		}
+
+	private:
+		std::vector<time_t> _times;
+		std::vector<rnd_generator::value_type> _draw;
+	};
+
+	/** chance that a block arrives at or before a time */
+	typedef std::function<double(time_t)> arrival_cdf;
+
+	/** arrival cdf of a generator, which must outlive it */
+	inline arrival_cdf cdf_of(const rnd_generator &gen) {
+		return [&gen] (time_t t) -> double {
+			return (t < 0) ? 0 : gen.cdf(rnd_generator::value_type(t));
+		};
+	}
+
+	/** a block with latency a with chance p and b otherwise */
+	inline arrival_cdf mixture(double p, const arrival_cdf &a,
+			const arrival_cdf &b) {
+		return [p, a, b] (time_t t) -> double {
+			return p * a(t) + (1 - p) * b(t);
+		};
+	}
+
+	/**
+	 * Exact completion time of k-of-n loads with @ref min_coder: the
+	 * arrival of the m-th earliest of independent blocks, m = k - C
+	 * with C blocks cached. Blocks come in groups of the same arrival
+	 * cdf F. The m-th arrival is at or before t iff at least m blocks
+	 * are, a binomial count of chance F(t) per group: one group gives
+	 * the regularized incomplete beta I_F(t)(m, n - m + 1), more groups
+	 * convolve the counts of all but the last one. Arrival times are
+	 * integers, so the mean is the sum of the chance to exceed each
+	 * time and quantiles come from a binary search on the cdf.
+	 */
+	class kofn_exact {
+	public:
+		typedef unsigned int size_type;
+
+		/** drop every block */
+		void clear(void) { _groups.clear(); }
+
+		/** add count blocks whose arrival follows cdf */
+		void add(size_type count, const arrival_cdf &cdf) {
+			if (count > 0) {
+				_groups.push_back(group(count, cdf));
+			}
+		}
+
+		size_type size(void) const {
+			size_type n = 0;
+			for (const group &g : _groups) {
+				n += g.count;
+			}
+			return n;
+		}
+
+		/** chance that the m-th earliest of the blocks arrives at or
+		 * before t, 1 <= m <= size() */
+		double cdf(size_type m, time_t t) const {
+			const group &last = _groups.back();
+			double p = last.cdf(t);
+			if (_groups.size() == 1) {
+				return at_least(m, last.count, p);
+			}
+			// pmf of the number of blocks of the other groups by t
+			std::vector<double> count(1, 1.0);
+			std::vector<double> pmf, sum;
+			for (size_t g = 0; g + 1 < _groups.size(); ++g) {
+				binomial(_groups[g].count, _groups[g].cdf(t), pmf);
+				sum.assign(count.size() + pmf.size() - 1, 0);
+				for (size_t i = 0; i < count.size(); ++i) {
+					for (size_t j = 0; j < pmf.size(); ++j) {
+						sum[i + j] += count[i] * pmf[j];
+					}
+				}
+				count.swap(sum);
+			}
+			double result = 0;
+			for (size_t j = 0; j < count.size(); ++j) {
+				result += count[j] * ((j >= m) ? 1 :
+					at_least(m - j, last.count, p));
+			}
+			return std::min(1.0, result);
+		}
+
+		/** smallest time the m-th arrival is at or before with chance
+		 * at least q < 1 */
+		time_t quantile(size_type m, double q) const {
+			time_t lo = 0, hi = 1;
+			while (cdf(m, hi) < q) {
+				lo = hi;
+				hi *= 2;
+			}
+			if (cdf(m, 0) >= q) {
+				return 0;
+			}
+			// cdf(lo) < q <= cdf(hi)
+			while (hi - lo > 1) {
+				time_t mid = lo + (hi - lo) / 2;
+				if (cdf(m, mid) < q) {
+					lo = mid;
+				} else {
+					hi = mid;
+				}
+			}
+			return hi;
+		}
+
+		/** mean arrival of the m-th earliest block */
+		double mean(size_type m) const {
+			// the chance to exceed t is 1 up to lo and 0 from hi on
+			// within 1e-12
+			const double eps = 1e-12;
+			time_t lo = quantile(m, eps);
+			time_t hi = quantile(m, 1 - eps);
+			double sum = lo;
+			for (time_t t = lo; t < hi; ++t) {
+				sum += 1 - cdf(m, t);
+			}
+			return sum;
+		}
+
+	private:
+		struct group {
+			size_type count;
+			arrival_cdf cdf;
+			group(size_type n, const arrival_cdf &f) : count(n), cdf(f) {}
+		};
+		std::vector<group> _groups;
+
+		/* chance that at least m of n blocks arrived when each did
+		 * with chance p, I_p(m, n - m + 1) */
+		static double at_least(size_type m, size_type n, double p) {
+			if (m == 0) {
+				return 1;
+			}
+			if (m > n || p <= 0) {
+				return 0;
+			}
+			if (p >= 1) {
+				return 1;
+			}
+			return beta_i(m, n - m + 1.0, p);
+		}
+
+		/* binomial pmf of n trials of chance p */
+		static void binomial(size_type n, double p,
+				std::vector<double> &pmf) {
+			pmf.assign(n + 1, 0);
+			if (p <= 0 || p >= 1) {
+				pmf[(p <= 0) ? 0 : n] = 1;
+				return;
+			}
+			double lp = std::log(p), lq = std::log1p(-p);
+			for (size_type j = 0; j <= n; ++j) {
+				pmf[j] = std::exp(std::lgamma(n + 1.0) -
+					std::lgamma(j + 1.0) - std::lgamma(n - j + 1.0) +
+					j * lp + (n - j) * lq);
+			}
+		}
+
+		/* regularized incomplete beta I_x(a, b), by the continued
+		 * fraction on the side of x where it converges fast */
+		static double beta_i(double a, double b, double x) {
+			double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+				std::lgamma(b) + a * std::log(x) + b * std::log1p(-x));
+			if (x < (a + 1) / (a + b + 2)) {
+				return front * beta_cf(a, b, x) / a;
+			}
+			return 1 - front * beta_cf(b, a, 1 - x) / b;
+		}
+
+		/* continued fraction of the incomplete beta (modified Lentz) */
+		static double beta_cf(double a, double b, double x) {
+			const double eps = 1e-15;
+			const double tiny = 1e-300;
+			double c = 1;
+			double d = 1 - (a + b) * x / (a + 1);
+			d = 1 / ((std::fabs(d) < tiny) ? tiny : d);
+			double h = d;
+			for (int i = 1; i < 100000; ++i) {
+				// even then odd step of the fraction
+				for (int odd = 0; odd < 2; ++odd) {
+					double num = odd ?
+						-(a + i) * (a + b + i) * x /
+							((a + 2 * i) * (a + 2 * i + 1)) :
+						i * (b - i) * x /
+							((a + 2 * i - 1) * (a + 2 * i));
+					d = 1 + num * d;
+					d = 1 / ((std::fabs(d) < tiny) ? tiny : d);
+					c = 1 + num / c;
+					c = (std::fabs(c) < tiny) ? tiny : c;
+					h *= d * c;
+				}
+				if (std::fabs(d * c - 1) < eps) {
+					break;
+				}
+			}
+			return h;
+		}
+	};
+
+}
+
+#endif
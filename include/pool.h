@@ -0,0 +1,56 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+
+namespace strsim {
+
+	/**
+	 * Fixed set of worker threads running a batch of independent tasks
+	 * with work stealing. Task ids are dealt to the workers in
+	 * contiguous ranges, a worker runs its own tasks first and then
+	 * steals from the other end of the busiest queue, so uneven tasks
+	 * still keep every worker busy until the batch is done.
+	 */
+	class task_pool {
+	public:
+		typedef unsigned int size_type;
+		/** task(id, worker) with worker in [0, workers()) */
+		typedef std::function<void(size_type, unsigned int)> task_type;
+		/** progress(done) after every finished task, one call at a time */
+		typedef std::function<void(size_type)> progress_type;
+
+		/** pool of the given number of workers, 0 for one per core */
+		task_pool(unsigned int workers = 0);
+
+		unsigned int workers(void) const { return _workers; }
+
+		/**
+		 * @brief run task ids 0 to count - 1 and wait for all of them.
+		 * The calling thread is one of the workers.
+		 */
+		void run(size_type count, const task_type &task,
+				const progress_type &progress = progress_type());
+
+	private:
+		struct queue {
+			std::mutex lock;
+			std::deque<size_type> tasks;
+		};
+		unsigned int _workers;
+		std::vector<queue> _queues;
+		std::mutex _progress_lock;
+		size_type _done;
+
+		/** next task for a worker, false once every queue is empty */
+		bool next(unsigned int worker, size_type &id);
+		void work(unsigned int worker, const task_type &task,
+				const progress_type &progress);
+	};
+
+}
+
+#endif
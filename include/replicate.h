@@ -0,0 +1,52 @@
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include <cmath>
+#include <limits>
+
+namespace strsim {
+
+	/**
+	 * Estimates of one quantity from independent replicates, such as
+	 * chunks of trials. Their spread gives the standard error of their
+	 * mean whatever ties the trials inside a replicate together
+	 * (antithetic pairs, points of one scrambled quasi-random set, ...).
+	 * Moments are updated with Welford's method.
+	 */
+	class replicates {
+	public:
+		replicates() : _count(0), _mean(0), _m2(0) {}
+
+		void add(double estimate) {
+			_count++;
+			double delta = estimate - _mean;
+			_mean += delta / _count;
+			_m2 += delta * (estimate - _mean);
+		}
+
+		unsigned long count(void) const { return _count; }
+
+		/** mean of the estimates, nan without any */
+		double mean(void) const {
+			return (_count == 0) ?
+				std::numeric_limits<double>::quiet_NaN() : _mean;
+		}
+
+		/** standard error of the mean, nan below two replicates */
+		double std_error(void) const {
+			if (_count < 2) {
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+			return std::sqrt(_m2 / (_count - 1) / _count);
+		}
+
+	private:
+		unsigned long _count;
+		double _mean;
+		// sum of squared deviations from the mean
+		double _m2;
+	};
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <atomic>
+#include <random>
+#include "sobol.h"
+
+namespace strsim {
+
+	/**
+	 * Philox4x32-10 counter-based random engine (Salmon et al., Random123).
+	 * Word i of a stream is a pure function of (key, stream, i), so any
+	 * stream and any position in it can be generated on its own, and the
+	 * whole state is a few words instead of the 5 KB of std::mt19937.
+	 * The engine is a UniformRandomBitGenerator, it drives the standard
+	 * distributions like any other engine.
+	 */
+	class philox {
+	public:
+		typedef uint32_t result_type;
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return 0xffffffff; }
+
+		philox(uint64_t key = 0, uint64_t stream = 0) : _point(0), _dim(0),
+				_cached(0) {
+			seed(key, stream);
+		}
+
+		/** restart from the first word of a stream */
+		void seed(uint64_t key, uint64_t stream = 0) {
+			_key = key;
+			_stream = stream;
+			_pos = 0;
+			_quasi = false;
+		}
+
+		/**
+		 * @brief switch to quasi-random words and restart: word d is
+		 * coordinate dim + d of a point of the @ref sobol sequence,
+		 * Owen scrambled with word dim + d of the stream, so every
+		 * stream is an independent randomisation of the same points.
+		 * Coordinates past sobol::DIMS are plain random words of the
+		 * point. seed() goes back to plain words.
+		 */
+		void quasi(uint64_t point, uint64_t dim = 0) {
+			_quasi = true;
+			_point = point;
+			_dim = dim;
+			_pos = 0;
+			_cached = ~uint64_t(0);
+		}
+
+		result_type operator()() {
+			if (_quasi) {
+				return quasi_word(_pos++);
+			}
+			if ((_pos & 3) == 0) {
+				block(_key, _stream, _pos >> 2, _out);
+			}
+			return _out[_pos++ & 3];
+		}
+
+		/** skip n words in constant time */
+		void discard(uint64_t n) {
+			_pos += n;
+			if (!_quasi && (_pos & 3) != 0) {
+				block(_key, _stream, _pos >> 2, _out);
+			}
+		}
+
+		/** the next count words, whole blocks go straight to out */
+		void generate(result_type * out, size_t count) {
+			if (_quasi) {
+				for (size_t i = 0; i < count; ++i) {
+					out[i] = quasi_word(_pos++);
+				}
+				return;
+			}
+			while (count > 0 && (_pos & 3) != 0) {
+				*out++ = (*this)();
+				count--;
+			}
+			for (; count >= 4; count -= 4, out += 4, _pos += 4) {
+				block(_key, _stream, _pos >> 2, out);
+			}
+			while (count > 0) {
+				*out++ = (*this)();
+				count--;
+			}
+		}
+
+		/** words 4 * index to 4 * index + 3 of a stream */
+		static void block(uint64_t key, uint64_t stream, uint64_t index,
+				result_type * out) {
+			uint32_t c0 = uint32_t(index);
+			uint32_t c1 = uint32_t(index >> 32);
+			uint32_t c2 = uint32_t(stream);
+			uint32_t c3 = uint32_t(stream >> 32);
+			uint32_t k0 = uint32_t(key);
+			uint32_t k1 = uint32_t(key >> 32);
+			for (int r = 0; r < 10; ++r) {
+				uint64_t p0 = uint64_t(0xD2511F53) * c0;
+				uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+				c0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+				c1 = uint32_t(p1);
+				c2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+				c3 = uint32_t(p0);
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+			out[0] = c0;
+			out[1] = c1;
+			out[2] = c2;
+			out[3] = c3;
+		}
+
+	private:
+		uint64_t _key;
+		uint64_t _stream;
+		// position of the next word in the stream
+		uint64_t _pos;
+		result_type _out[4];
+		// quasi-random mode, point and first coordinate, and the block
+		// of scrambling or padding words held in _out
+		bool _quasi;
+		uint64_t _point;
+		uint64_t _dim;
+		uint64_t _cached;
+
+		result_type quasi_word(uint64_t pos) {
+			uint64_t c = _dim + pos;
+			// the scrambling words of the table come first in the
+			// stream, the padding words of each point after them
+			uint64_t index = (c < sobol::DIMS) ? c >> 2 :
+				((_point + 1) << 32) + ((c - sobol::DIMS) >> 2);
+			if (index != _cached) {
+				block(_key, _stream, index, _out);
+				_cached = index;
+			}
+			if (c < sobol::DIMS) {
+				return sobol::scramble(sobol::coordinate(_point, c),
+						_out[c & 3]);
+			}
+			return _out[c & 3];
+		}
+	};
+
+	namespace detail {
+		struct seeding {
+			uint64_t seed;
+			std::atomic<uint64_t> stream;
+			seeding() : stream(0) {
+				const char * env = std::getenv("STRSIM_SEED");
+				seed = (env != nullptr) ? std::strtoull(env, nullptr, 0) :
+					(uint64_t(std::random_device()()) << 32) |
+					std::random_device()();
+			}
+		};
+		inline seeding& global_seeding(void) {
+			static seeding s;
+			return s;
+		}
+	}
+
+	/** key of the generators built without one, taken from the
+	 * STRSIM_SEED environment variable or random if it is not set */
+	inline uint64_t global_seed(void) {
+		return detail::global_seeding().seed;
+	}
+
+	/** change the key of the generators built from now on */
+	inline void global_seed(uint64_t seed) {
+		detail::global_seeding().seed = seed;
+	}
+
+	/** a stream of the global key no other generator got from here,
+	 * streams are handed out in construction order */
+	inline uint64_t next_stream(void) {
+		return detail::global_seeding().stream++;
+	}
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace strsim {
+
+	/**
+	 * @brief xor a buffer into another, dst ^= src.
+	 * The widest kernel supported by the CPU (AVX2, SSE2 or 64-bit
+	 * words) is picked at runtime on the first call.
+	 *
+	 * @param[in,out] dst buffer to update
+	 * @param[in] src buffer to xor into dst
+	 * @param[in] len number of bytes
+	 */
+	void xor_block(uint8_t * dst, const uint8_t * src, size_t len);
+
+	/** name of the kernel used by @ref xor_block */
+	const char * xor_kernel(void);
+
+	/** product of two elements of GF(2^8), polynomial 0x11d */
+	uint8_t gf_mul(uint8_t a, uint8_t b);
+
+	/** inverse of a non-zero element of GF(2^8) */
+	uint8_t gf_inv(uint8_t a);
+
+	/**
+	 * @brief multiply a buffer by a constant of GF(2^8) and add it to
+	 * another, dst ^= c * src.
+	 * Products are looked up in two 16-entry tables, one per nibble,
+	 * with PSHUFB (AVX2 or SSSE3) when the CPU has it.
+	 *
+	 * @param[in,out] dst buffer to update
+	 * @param[in] src buffer to multiply
+	 * @param[in] c constant
+	 * @param[in] len number of bytes
+	 */
+	void gf_mul_add(uint8_t * dst, const uint8_t * src, uint8_t c,
+			size_t len);
+
+	/** name of the kernel used by @ref gf_mul_add */
+	const char * gf_kernel(void);
+
+	/**
+	 * @brief standard normal samples by Box-Muller, 4 pairs at a time
+	 * with AVX2 when the CPU has it.
+	 * Words are uniform random numbers, words[i] and words[pairs + i]
+	 * give out[i] and out[pairs + i].
+	 *
+	 * @param[in] words 2 * pairs random words
+	 * @param[out] out 2 * pairs samples
+	 * @param[in] pairs number of pairs
+	 */
+	void normal_fill(const uint32_t * words, double * out, size_t pairs);
+
+	/**
+	 * @brief standard exponential samples, out[i] = -ln(u) where u is
+	 * words[i] mapped to (0, 1)
+	 */
+	void exponential_fill(const uint32_t * words, double * out,
+			size_t count);
+
+	/** name of the kernel used by @ref normal_fill and
+	 * @ref exponential_fill, every kernel gives the same samples */
+	const char * math_kernel(void);
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cmath>
+#include <cstdint>
+
+namespace strsim {
+
+	/**
+	 * Mergeable quantile sketch of non-negative integers, HDR histogram
+	 * style. Values below 2^bits are counted exactly, larger ones fall
+	 * into log-linear buckets 2^-bits wide relative to the value, so a
+	 * quantile is off by at most the relative error asked for. Memory
+	 * only grows with the magnitude of the largest value, never with
+	 * the number of samples.
+	 */
+	class quantile_sketch {
+	public:
+		typedef uint64_t value_type;
+		typedef uint64_t count_type;
+
+		/** percentiles reported by the simulators */
+		static constexpr double P50 = 0.5;
+		static constexpr double P90 = 0.9;
+		static constexpr double P99 = 0.99;
+		static constexpr double P999 = 0.999;
+		static constexpr double P9999 = 0.9999;
+
+		quantile_sketch(double rel_error = 0.001) :
+				_bits(1), _count(0), _sum(0) {
+			while (std::ldexp(1.0, -int(_bits)) > rel_error && _bits < 32) {
+				_bits++;
+			}
+		}
+
+		/** record n samples of value v */
+		void add(value_type v, count_type n = 1) {
+			size_t i = index(v);
+			if (i >= _buckets.size()) {
+				_buckets.resize(i + 1, 0);
+			}
+			_buckets[i] += n;
+			_count += n;
+			_sum += v * n;
+		}
+
+		/** merge the samples of a sketch with the same relative error */
+		quantile_sketch& operator+= (const quantile_sketch &other) {
+			if (other._buckets.size() > _buckets.size()) {
+				_buckets.resize(other._buckets.size(), 0);
+			}
+			for (size_t i = 0; i < other._buckets.size(); ++i) {
+				_buckets[i] += other._buckets[i];
+			}
+			_count += other._count;
+			_sum += other._sum;
+			return *this;
+		}
+
+		count_type count(void) const { return _count; }
+		bool empty(void) const { return _count == 0; }
+		/** exact sum of the samples */
+		value_type sum(void) const { return _sum; }
+
+		/**
+		 * @brief value of rank floor(q * count) among the samples
+		 * sorted from 0, the same one as sorted[count * q] on a sorted
+		 * vector of the samples
+		 */
+		value_type quantile(double q) const {
+			if (_count == 0) {
+				return 0;
+			}
+			count_type rank = count_type(q * _count);
+			if (rank >= _count) {
+				rank = _count - 1;
+			}
+			count_type seen = 0;
+			for (size_t i = 0; i < _buckets.size(); ++i) {
+				seen += _buckets[i];
+				if (seen > rank) {
+					return value(i);
+				}
+			}
+			return value(_buckets.size() - 1);
+		}
+
+		/** names of the columns written by write_percentiles */
+		static std::string percentile_header(const std::string &prefix = "") {
+			return prefix + "p50," + prefix + "p90," + prefix + "p99," +
+				prefix + "p999," + prefix + "p9999";
+		}
+
+		/** write p50, p90, p99, p99.9 and p99.99 separated by commas */
+		void write_percentiles(std::ostream &out) const {
+			out << quantile(P50) << "," << quantile(P90) << "," <<
+				quantile(P99) << "," << quantile(P999) << "," <<
+				quantile(P9999);
+		}
+
+	private:
+		unsigned int _bits;
+		count_type _count;
+		value_type _sum;
+		std::vector<count_type> _buckets;
+
+		/* values below 2^bits map to themselves, above that the top
+		 * bits of the value pick one of 2^(bits-1) buckets per octave */
+		size_t index(value_type v) const {
+			if (v < (value_type(1) << _bits)) {
+				return v;
+			}
+			unsigned int shift = 63 - __builtin_clzll(v) - (_bits - 1);
+			return (size_t(shift) << (_bits - 1)) + (v >> shift);
+		}
+
+		/* middle of a bucket */
+		value_type value(size_t i) const {
+			if (i < (size_t(1) << _bits)) {
+				return i;
+			}
+			size_t half = size_t(1) << (_bits - 1);
+			unsigned int shift = i / half - 1;
+			value_type top = half + i % half;
+			return (top << shift) + (value_type(1) << (shift - 1));
+		}
+	};
+
+}
+
+#endif
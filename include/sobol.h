@@ -0,0 +1,161 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <cstdint>
+#include <vector>
+
+namespace strsim {
+
+	/**
+	 * Sobol low-discrepancy sequence in base 2 with Owen scrambling.
+	 * The direction numbers of the first DIMS dimensions are built once
+	 * from the primitive polynomials over GF(2) in increasing order of
+	 * degree; the initial direction numbers are fixed odd numbers drawn
+	 * from a hash instead of the optimised Joe-Kuo tables, so the
+	 * sequence is a valid (t, s)-sequence with no tuned 2D projections.
+	 */
+	class sobol {
+	public:
+		/** dimensions with direction numbers */
+		static const unsigned int DIMS = 1024;
+		static const unsigned int BITS = 32;
+
+		/** coordinate dim < DIMS of point index, as a 32-bit fraction */
+		static uint32_t coordinate(uint64_t index, unsigned int dim) {
+			const uint32_t * v = &directions()[size_t(dim) * BITS];
+			uint32_t x = 0;
+			for (unsigned int b = 0; index != 0 && b < BITS;
+					++b, index >>= 1) {
+				if (index & 1) {
+					x ^= v[b];
+				}
+			}
+			return x;
+		}
+
+		/**
+		 * @brief nested uniform (Owen) scrambling of a coordinate,
+		 * with the hash of Laine and Karras applied to the reversed
+		 * bits as in Burley's "Practical Hash-based Owen Scrambling".
+		 * Every seed gives an independent scrambling.
+		 */
+		static uint32_t scramble(uint32_t x, uint32_t seed) {
+			x = reverse(x);
+			x += seed;
+			x ^= x * 0x6c50b47c;
+			x ^= x * 0xb82f1e52;
+			x ^= x * 0xc7afe638;
+			x ^= x * 0x8d22f6e6;
+			return reverse(x);
+		}
+
+	private:
+		static uint32_t reverse(uint32_t x) {
+			x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+			x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+			x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+			x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+			return (x >> 16) | (x << 16);
+		}
+
+		/* a * b modulo the polynomial p of degree s over GF(2) */
+		static uint32_t mulmod(uint32_t a, uint32_t b, uint32_t p, int s) {
+			uint32_t r = 0;
+			for (; b != 0; b >>= 1) {
+				if (b & 1) {
+					r ^= a;
+				}
+				a <<= 1;
+				if ((a >> s) & 1) {
+					a ^= p;
+				}
+			}
+			return r;
+		}
+
+		/* x^e modulo p */
+		static uint32_t powmod(uint64_t e, uint32_t p, int s) {
+			uint32_t r = 1;
+			uint32_t x = mulmod(1, 2, p, s);
+			for (; e != 0; e >>= 1) {
+				if (e & 1) {
+					r = mulmod(r, x, p, s);
+				}
+				x = mulmod(x, x, p, s);
+			}
+			return r;
+		}
+
+		/* p is primitive iff x has order 2^s - 1 modulo p */
+		static bool primitive(uint32_t p, int s) {
+			uint64_t order = (uint64_t(1) << s) - 1;
+			if (powmod(order, p, s) != 1) {
+				return false;
+			}
+			uint64_t n = order;
+			for (uint64_t q = 2; q * q <= n; ++q) {
+				if (n % q != 0) {
+					continue;
+				}
+				while (n % q == 0) {
+					n /= q;
+				}
+				if (powmod(order / q, p, s) == 1) {
+					return false;
+				}
+			}
+			return n == 1 || powmod(order / n, p, s) != 1;
+		}
+
+		/* direction numbers, BITS per dimension */
+		static const std::vector<uint32_t>& directions(void) {
+			static const std::vector<uint32_t> table = build();
+			return table;
+		}
+
+		static std::vector<uint32_t> build(void) {
+			std::vector<uint32_t> v(size_t(DIMS) * BITS);
+			// the first dimension is the van der Corput sequence
+			for (unsigned int b = 0; b < BITS; ++b) {
+				v[b] = uint32_t(1) << (BITS - 1 - b);
+			}
+			unsigned int dim = 1;
+			uint64_t hash = 0x9e3779b97f4a7c15;
+			for (int s = 1; dim < DIMS; ++s) {
+				for (uint32_t p = (1 << s) | 1; p < (2u << s) &&
+						dim < DIMS; p += 2) {
+					if (!primitive(p, s)) {
+						continue;
+					}
+					uint64_t m[BITS + 1];
+					for (int k = 1; k <= s && k <= int(BITS); ++k) {
+						// splitmix64 picks an odd m_k < 2^k
+						hash += 0x9e3779b97f4a7c15;
+						uint64_t z = hash;
+						z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+						z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+						z ^= z >> 31;
+						m[k] = (z & ((uint64_t(1) << k) - 1)) | 1;
+					}
+					for (int k = s + 1; k <= int(BITS); ++k) {
+						m[k] = m[k - s] ^ (m[k - s] << s);
+						for (int j = 1; j < s; ++j) {
+							if ((p >> (s - j)) & 1) {
+								m[k] ^= m[k - j] << j;
+							}
+						}
+					}
+					for (unsigned int b = 0; b < BITS; ++b) {
+						v[size_t(dim) * BITS + b] =
+							uint32_t(m[b + 1] << (BITS - 1 - b));
+					}
+					dim++;
+				}
+			}
+			return v;
+		}
+	};
+
+}
+
+#endif
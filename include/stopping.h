@@ -0,0 +1,121 @@
+#ifndef STOPPING_H
+#define STOPPING_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+namespace strsim {
+
+	/**
+	 * Sequential stopping rule: a configuration keeps running batches
+	 * of trials until the confidence interval of its metric, the mean
+	 * or a quantile of the latency, is narrower than a target relative
+	 * half-width.
+	 */
+	class stopping_rule {
+	public:
+		stopping_rule() : _quantile(0), _half_width(0), _z(0) {}
+
+		/**
+		 * @brief read "metric:half_width[:confidence]", metric being
+		 * mean or pXX (p99, p99.9, ...), half_width relative to the
+		 * estimate and confidence 0.95 by default. False if malformed.
+		 */
+		bool parse(const std::string &spec) {
+			size_t colon = spec.find(':');
+			if (colon == std::string::npos) {
+				return false;
+			}
+			std::string metric = spec.substr(0, colon);
+			std::string rest = spec.substr(colon + 1);
+			size_t next = rest.find(':');
+			try {
+				_half_width = std::stod(rest.substr(0, next));
+				double confidence = (next == std::string::npos) ? 0.95 :
+					std::stod(rest.substr(next + 1));
+				if (confidence <= 0 || confidence >= 1) {
+					return false;
+				}
+				_z = normal_z(confidence);
+				if (metric == "mean") {
+					_quantile = 0;
+				} else if (metric.size() > 1 && metric[0] == 'p') {
+					_quantile = std::stod(metric.substr(1)) / 100;
+					if (_quantile <= 0 || _quantile >= 1) {
+						return false;
+					}
+				} else {
+					return false;
+				}
+			} catch (const std::logic_error &) {
+				return false;
+			}
+			_metric = metric;
+			return _half_width > 0;
+		}
+
+		/** false for the fixed number of trials */
+		bool active(void) const { return _half_width > 0; }
+		const std::string& metric(void) const { return _metric; }
+		/** quantile of the metric, 0 for the mean */
+		double quantile(void) const { return _quantile; }
+		/** normal quantile of the confidence level */
+		double z(void) const { return _z; }
+
+		/** relative half-width of an interval around an estimate */
+		static double relative(double estimate, double lo, double hi) {
+			return (hi - lo) / 2 / std::fabs(estimate);
+		}
+
+		/** whether a relative half-width meets the target */
+		bool met(double relative) const {
+			return relative <= _half_width;
+		}
+
+		/** z with P(|Z| <= z) = confidence for a standard normal Z */
+		static double normal_z(double confidence) {
+			double lo = 0, hi = 40;
+			for (int i = 0; i < 100; ++i) {
+				double mid = (lo + hi) / 2;
+				if (std::erf(mid / std::sqrt(2.0)) < confidence) {
+					lo = mid;
+				} else {
+					hi = mid;
+				}
+			}
+			return (lo + hi) / 2;
+		}
+
+		/**
+		 * @brief distribution-free interval of the q quantile of
+		 * independent trials in ascending order: the ranks within z
+		 * standard deviations of the binomial count of trials below
+		 * the quantile. A bound past the trials is infinite.
+		 */
+		template <typename T>
+		static void order_interval(const std::vector<T> &sorted, double q,
+				double z, double &estimate, double &lo, double &hi) {
+			const double inf = std::numeric_limits<double>::infinity();
+			double n = sorted.size();
+			double spread = z * std::sqrt(n * q * (1 - q));
+			double low = std::floor(n * q - spread);
+			double high = std::ceil(n * q + spread);
+			estimate = sorted[size_t(std::min(n - 1, std::floor(n * q)))];
+			lo = (low < 0) ? -inf : sorted[size_t(low)];
+			hi = (high > n - 1) ? inf : sorted[size_t(high)];
+		}
+
+	private:
+		std::string _metric;
+		double _quantile;
+		double _half_width;
+		double _z;
+	};
+
+}
+
+#endif
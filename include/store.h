@@ -3,52 +3,198 @@
 
 #include "code.h"
 #include "common.h"
+#include "rng.h"
 #include <vector>
 #include <random>
 #include <math.h>
 
 namespace strsim {
 
+	/**
+	 * Delay plus a Gamma(shape, rate) latency, an Erlang latency when
+	 * the shape is an integer. Samples are drawn with Marsaglia and
+	 * Tsang's method, so they cost the same whatever the shape, which
+	 * does not have to be an integer.
+	 */
 	class erlang_generator : public rnd_generator {
 	public:
-		erlang_generator() : _gen(std::random_device()()), _dist(0, 1) {};
-		erlang_generator(unsigned int shape, double rate, double delay) : 
+		erlang_generator() : _dist(0, 1), _normal(0, 1),
+				_antithetic(false), _theta(0) {
+			seed(global_seed(), next_stream());
+		};
+		erlang_generator(double shape, double rate, double delay) : 
 				erlang_generator() {
 			setup(shape, rate, delay);		
 		}
-		void setup(unsigned int shape, double rate, double delay);
+		void setup(double shape, double rate, double delay);
+		/** Sample i of a batch always starts from the same words,
+		 * rejected candidates are redrawn from a spare stream, so
+		 * antithetic and common random batches stay paired sample
+		 * by sample */
+		void sample_batch(value_type * out, size_t count);
+		/** restart the random sequence from a stream of a key */
+		void seed(uint64_t key, uint64_t stream = 0) {
+			_gen.seed(key, stream);
+			_spare.seed(~key, stream);
+			_dist.reset();
+			_normal.reset();
+			_log_weight = 0;
+		}
+		/** draw from quasi-random words, see philox::quasi */
+		void quasi(uint64_t point, uint64_t dim = 0) {
+			_gen.quasi(point, dim);
+			_dist.reset();
+			_normal.reset();
+			_log_weight = 0;
+		}
+		/** antithetic draws: every normal x becomes -x and every
+		 * uniform u becomes 1 - u */
+		void antithetic(bool on) { _antithetic = on; }
+		/**
+		 * @brief importance sampling: draw from the exponential tilt
+		 * of the gamma latency whose mean is theta standard deviations
+		 * higher, the rate divided by 1 + theta / sqrt(shape)
+		 */
+		void tilt(double theta);
+		/** log of the likelihood ratio of the samples drawn since the
+		 * last seed() or quasi() */
+		double log_weight(void) const { return _log_weight; }
+		/** chance that a sample of the untilted latency is at most
+		 * v, the same with antithetic draws */
+		double cdf(value_type v) const;
 		value_type virtual sample(void);
 	private:
-		std::mt19937 _gen;
+		philox _gen;
+		// words of the candidates a batch rejects
+		philox _spare;
 		std::uniform_real_distribution<double> _dist;
-		unsigned int _shape;
+		std::normal_distribution<double> _normal;
+		double _shape;
 		double _rate;
 		double _delay;
+		// Marsaglia-Tsang constants, d = a - 1/3 and c = 1 / sqrt(9d)
+		// for a = shape, or shape + 1 when the shape is below 1
+		double _d;
+		double _c;
+		bool _antithetic;
+		// tilt, rate of the tilted draws and log of their likelihood
+		// ratio so far
+		double _theta;
+		double _tilted_rate;
+		double _log_weight;
 	};
 
 	class gaussian_generator : public rnd_generator {
 	public:
-		gaussian_generator(double mu, double sigma) :
-		   	_gen(std::random_device()()), _dist(mu, sigma) {};
+		gaussian_generator(double mu, double sigma) : _dist(mu, sigma),
+				_sign(1), _shift(0), _log_norm(0) {
+			seed(global_seed(), next_stream());
+		};
 		gaussian_generator() : gaussian_generator(0.0, 10.0) {};
+		/** Box-Muller on whole batches. Sample i of a batch always
+		 * comes from the same words, negative samples are redrawn
+		 * from a spare stream, so a batch is the start of any longer
+		 * one and antithetic batches stay paired sample by sample. */
+		void sample_batch(value_type * out, size_t count);
+		/** restart the random sequence from a stream of a key */
+		void seed(uint64_t key, uint64_t stream = 0) {
+			_gen.seed(key, stream);
+			_spare.seed(~key, stream);
+			_dist.reset();
+			_log_weight = 0;
+		}
+		/** draw from quasi-random words, see philox::quasi */
+		void quasi(uint64_t point, uint64_t dim = 0) {
+			_gen.quasi(point, dim);
+			_dist.reset();
+			_log_weight = 0;
+		}
+		/** antithetic draws: samples are mirrored around the mean */
+		void antithetic(bool on) { _sign = on ? -1 : 1; }
+		/**
+		 * @brief importance sampling: draw from the exponential tilt
+		 * of the latency, the mean shifted by theta standard deviations
+		 */
+		void tilt(double theta);
+		/** log of the likelihood ratio of the samples drawn since the
+		 * last seed() or quasi() */
+		double log_weight(void) const { return _log_weight; }
+		/** chance that a sample of the untilted latency is at most
+		 * v, the same with antithetic draws */
+		double cdf(value_type v) const;
 		value_type virtual sample(void);
 	private: 
-		std::mt19937 _gen;
+		philox _gen;
+		// words of the samples a batch redraws
+		philox _spare;
 		std::normal_distribution<double> _dist;
+		double _sign;
+		// mean shift of the tilted draws, log of the ratio of the mass
+		// the truncation at 0 keeps with and without it, and log of the
+		// likelihood ratio so far
+		double _shift;
+		double _log_norm;
+		double _log_weight;
 	};
 	
 	class exponential_generator : public rnd_generator {
 	public:
 		exponential_generator(double lambda) :
-		   	_gen(std::random_device()()), _dist(lambda) {};
+		   	_gen(global_seed(), next_stream()), _dist(lambda),
+			_antithetic(false), _lambda(lambda), _log_weight(0) {};
 		exponential_generator() : exponential_generator(2.0) {};
+		void sample_batch(value_type * out, size_t count);
+		/** restart the random sequence from a stream of a key */
+		void seed(uint64_t key, uint64_t stream = 0) {
+			_gen.seed(key, stream);
+			_dist.reset();
+			_log_weight = 0;
+		}
+		/** draw from quasi-random words, see philox::quasi */
+		void quasi(uint64_t point, uint64_t dim = 0) {
+			_gen.quasi(point, dim);
+			_dist.reset();
+			_log_weight = 0;
+		}
+		/** antithetic draws: the uniform u behind every sample
+		 * becomes 1 - u */
+		void antithetic(bool on) { _antithetic = on; }
+		/**
+		 * @brief importance sampling: draw from the exponential tilt
+		 * of the latency whose mean is theta standard deviations
+		 * higher, the rate divided by 1 + theta
+		 */
+		void tilt(double theta);
+		/** log of the likelihood ratio of the samples drawn since the
+		 * last seed() or quasi() */
+		double log_weight(void) const { return _log_weight; }
+		/** chance that a sample of the untilted latency is at most
+		 * v, the same with antithetic draws */
+		double cdf(value_type v) const;
 		value_type virtual sample(void);
 	private: 
-		std::mt19937 _gen;
+		philox _gen;
 		std::exponential_distribution<double> _dist;
+		bool _antithetic;
+		// rate of the latency, the one of _dist is tilted
+		double _lambda;
+		double _log_weight;
 	};
 
-	
+	/**
+	 * Draw the arrival time of count blocks with one batch from the
+	 * generator, draw is scratch space reused from call to call
+	 */
+	inline void sample_arrivals(rnd_generator &gen,
+			coded_block * const * blocks, size_t count,
+			std::vector<rnd_generator::value_type> &draw) {
+		draw.resize(count);
+		gen.sample_batch(draw.data(), count);
+		for (size_t i = 0; i < count; ++i) {
+			blocks[i]->arrieve_time = draw[i];
+		}
+	}
+
 }
 
 #endif
@@ -0,0 +1,220 @@
+#ifndef TAIL_H
+#define TAIL_H
+
+#include <vector>
+#include <ctime>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace strsim {
+
+	/**
+	 * Quantiles of importance-sampled trials. Each trial adds its value
+	 * with the likelihood ratio of its draws as weight. The chance to
+	 * exceed a value is the weight of the trials above it over the
+	 * number of trials, unbiased whatever tilt drew them, and quantiles
+	 * are read off that tail. Confidence intervals invert the normal
+	 * interval of the tail probability at the quantile.
+	 */
+	class weighted_tail {
+	public:
+		typedef time_t value_type;
+
+		weighted_tail() : _sorted(false) {}
+
+		/** record a trial of value v and weight w */
+		void add(value_type v, double w) {
+			_trials.push_back(trial(v, w));
+			_sorted = false;
+		}
+
+		/** append the trials of another estimate */
+		weighted_tail& operator+= (const weighted_tail &other) {
+			_trials.insert(_trials.end(), other._trials.begin(),
+					other._trials.end());
+			_sorted = false;
+			return *this;
+		}
+
+		size_t count(void) const { return _trials.size(); }
+		bool empty(void) const { return _trials.empty(); }
+
+		/** unbiased mean of the value */
+		double mean(void) const {
+			double sum = 0;
+			for (const trial &t : _trials) {
+				sum += t.weight * t.value;
+			}
+			return sum / _trials.size();
+		}
+
+		/** standard error of mean() */
+		double std_error(void) const {
+			double m = mean();
+			double sq = 0;
+			for (const trial &t : _trials) {
+				double d = t.weight * t.value - m;
+				sq += d * d;
+			}
+			return std::sqrt(sq / (_trials.size() - 1) / _trials.size());
+		}
+
+		/** (sum w)^2 / sum w^2, the plain trials worth as many */
+		double effective_size(void) const {
+			double sum = 0, sq = 0;
+			for (const trial &t : _trials) {
+				sum += t.weight;
+				sq += t.weight * t.weight;
+			}
+			return sum * sum / sq;
+		}
+
+		/** smallest value exceeded with chance at most 1 - q */
+		value_type quantile(double q) {
+			return value_at(1 - q);
+		}
+
+		/**
+		 * @brief bounds of the confidence interval of the q quantile
+		 * at z standard errors of the tail probability. The upper
+		 * bound is infinite when the trials cannot rule out any value,
+		 * or when the quantile is the largest value seen.
+		 */
+		void interval(double q, double z, double &lo, double &hi) {
+			double p = 1 - q;
+			value_type t = value_at(p);
+			// chance and squared weight above the quantile
+			size_t above = std::upper_bound(_trials.begin(),
+				_trials.end(), trial(t, 0)) - _trials.begin();
+			double n = _trials.size();
+			double tail = _suffix[above] / n;
+			double var = (_suffix2[above] / n - tail * tail) / n;
+			double se = std::sqrt(std::max(var, 0.0));
+			lo = value_at(p + z * se);
+			hi = (p - z * se > 0 && above < _trials.size()) ?
+				value_at(p - z * se) :
+				std::numeric_limits<double>::infinity();
+		}
+
+	private:
+		struct trial {
+			value_type value;
+			double weight;
+			trial(value_type v, double w) : value(v), weight(w) {}
+			bool operator< (const trial &other) const {
+				return value < other.value;
+			}
+		};
+		std::vector<trial> _trials;
+		// sums of the weights and squared weights from each trial on
+		std::vector<double> _suffix;
+		std::vector<double> _suffix2;
+		bool _sorted;
+
+		void sort(void) {
+			if (_sorted) {
+				return;
+			}
+			std::sort(_trials.begin(), _trials.end());
+			_suffix.assign(_trials.size() + 1, 0);
+			_suffix2.assign(_trials.size() + 1, 0);
+			for (size_t i = _trials.size(); i > 0; --i) {
+				double w = _trials[i - 1].weight;
+				_suffix[i - 1] = _suffix[i] + w;
+				_suffix2[i - 1] = _suffix2[i] + w * w;
+			}
+			_sorted = true;
+		}
+
+		/* smallest trial value exceeded with chance at most p */
+		value_type value_at(double p) {
+			sort();
+			double n = _trials.size();
+			size_t i = _trials.size();
+			value_type result = _trials.back().value;
+			while (i > 0) {
+				value_type v = _trials[i - 1].value;
+				// _suffix[i] / n is the chance to exceed v
+				if (_suffix[i] / n > p) {
+					break;
+				}
+				result = v;
+				while (i > 0 && _trials[i - 1].value == v) {
+					i--;
+				}
+			}
+			return result;
+		}
+	};
+
+	/** normal latency a block has with chance share */
+	struct normal_part {
+		double share;
+		double mu;
+		double sigma;
+	};
+
+	/**
+	 * @brief correlation of the m-th earliest of n arrivals with the sum
+	 * of the arrival times, when each latency X is drawn from a mixture
+	 * of normal parts. By Bahadur's representation, the m-th arrival
+	 * moves with the count of blocks before the p = m / (n + 1)
+	 * quantile x of X, and the correlation is the one of X with the
+	 * indicator of X <= x: |cov(X, 1{X <= x})| / (sd(X) sqrt(p (1 - p))).
+	 */
+	inline double order_correlation(const std::vector<normal_part> &mix,
+			unsigned int m, unsigned int n) {
+		const double p = double(m) / (n + 1);
+		double lo = 0, hi = 0, mean = 0, square = 0;
+		for (const normal_part &c : mix) {
+			lo = std::min(lo, c.mu - 10 * c.sigma);
+			hi = std::max(hi, c.mu + 10 * c.sigma);
+			mean += c.share * c.mu;
+			square += c.share * (c.sigma * c.sigma + c.mu * c.mu);
+		}
+		// x by bisection on the cdf of the mixture
+		auto cdf = [&mix] (double x) -> double {
+			double f = 0;
+			for (const normal_part &c : mix) {
+				f += c.share * std::erfc(-(x - c.mu) /
+					(c.sigma * std::sqrt(2.0))) / 2;
+			}
+			return f;
+		};
+		for (int i = 0; i < 100; ++i) {
+			double mid = (lo + hi) / 2;
+			(cdf(mid) < p ? lo : hi) = mid;
+		}
+		// E[X 1{X <= x}], mu Phi(a) - sigma phi(a) for each part
+		double below = 0;
+		for (const normal_part &c : mix) {
+			double a = (lo - c.mu) / c.sigma;
+			below += c.share * (c.mu * std::erfc(-a / std::sqrt(2.0)) / 2 -
+				c.sigma * std::exp(-a * a / 2) / std::sqrt(2 * std::acos(-1.0)));
+		}
+		double var = square - mean * mean;
+		if (var <= 0 || p <= 0 || p >= 1) {
+			return 0;
+		}
+		return std::fabs(below - mean * p) /
+			std::sqrt(var * p * (1 - p));
+	}
+
+	/**
+	 * @brief shift, in standard deviations, of the sum of the arrival
+	 * times of a trial that minimises the variance of the estimated
+	 * chance for an order statistic of correlation rho with that sum to
+	 * pass its quantile z standard deviations out: rho z / (2 - rho^2),
+	 * at most cap. The log-likelihood ratio of a trial has about this
+	 * standard deviation, so its trials are worth about e^-(shift^2)
+	 * as many plain ones, and each of n blocks is tilted by shift /
+	 * sqrt(n) of its own standard deviations.
+	 */
+	inline double importance_shift(double rho, double z, double cap) {
+		return std::max(0.0, std::min(rho * z / (2 - rho * rho), cap));
+	}
+
+}
+
+#endif
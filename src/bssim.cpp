@@ -7,10 +7,48 @@
  * 	- dup_factod
  * 	- cache_factor (step of increment)
  * 	- max_cachefactor
+ * 	- coder: min (default), rs or luby
+ * 	- block_size: bytes of real data per block, 0 (default) only
+ * 	counts blocks
+ * 	- workers: number of threads, 0 (default) for one per core
+ * 	- seed: key of every random choice, STRSIM_SEED or random by
+ * 	default. Runs with the same seed give the same results whatever
+ * 	the number of workers
+ * 	- mode: variance reduction of the trials, plain (default) Monte
+ * 	Carlo, crn (common random numbers, trial i of every cell draws
+ * 	the same arrivals), antithetic (trials in pairs, the second one
+ * 	mirrors the arrivals of the first) or sobol (each chunk of trials
+ * 	takes its arrivals from its own scrambling of a Sobol sequence)
+ * 	or importance (arrivals drawn from slower, tilted latencies and
+ * 	trials weighted by their likelihood ratio)
+ * 	- tilt: with importance sampling, the most standard deviations
+ * 	the sum of the latencies of a trial is shifted by, 1 by default.
+ * 	Each setting shifts it as far as minimises the variance for the
+ * 	p99.9 of the arrival the data waits for, up to tilt, spread over
+ * 	its blocks. Trials are then worth about e^-(shift^2) plain ones
+ * 	- STRSIM_ENCODING_POOL: dir[:count] has luby draw its encodings
+ * 	from count (1000 by default) verified ones per duplication factor,
+ * 	kept in dir and built there by the first run of a raw size and
+ * 	seed, instead of encoding and checking each one
+ * 	- stop: metric:half_width[:confidence] runs each setting in rounds
+ * 	of trials until the confidence interval (0.95 by default) of the
+ * 	metric, mean or a percentile such as p99 or p99.9, is narrower
+ * 	than half_width times the estimate, instead of a fixed number of
+ * 	trials
  * Output:
  *  - The CMF of arrival time
  *  - The CMF of completion time with different amount of caching
  *  - The average and tail latency with diffrent amount of caching
+ *  - The p50, p90, p99, p99.9 and p99.99 latency of each setting
+ *  - The average CPU time spent decoding a trial when blocks carry data
+ *  - The standard error of the average and tail latency, and the
+ *  difference of the average latency to the cell without cache with
+ *  its standard error, from the spread of chunks of trials
+ *  - The trials run for each setting and the relative half-width of
+ *  the confidence interval of the metric of the stopping rule
+ *  - With importance sampling, the unbiased mean and p99 to p99.999
+ *  latency of each setting with their 95% confidence intervals; the
+ *  other outputs then describe the tilted trials
  *
  * */
 
@@ -19,136 +57,502 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
-#include <thread>
 #include <chrono>
+#include <random>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <deque>
+#include <cstdlib>
 #include "code.h"
 #include "store.h"
+#include "cmf.h"
+#include "sketch.h"
+#include "kofn.h"
+#include "arrival.h"
+#include "pool.h"
+#include "replicate.h"
+#include "tail.h"
+#include "stopping.h"
+#include "encpool.h"
 
 #define MU 4
 #define SIGMA 1
 
+#define ROBUST_C 0.03
+#define ROBUST_DELTA 0.5
+// verified encodings per pool by default
+#define POOL_SIZE 1000
+
 #define NUM_TEST 10000
+#define CHUNK_TEST 250
+// importance sampling estimates are trusted from this effective number
+// of trials on
+#define MIN_EFFECTIVE 100
+// trials of a setting at most, and chunks it runs a round, when
+// stopping on a confidence target
+#define MAX_TEST 100000
+#define ROUND_CHUNK 4
+// deepest percentile of importance sampling and the normal quantile of
+// its 95% confidence intervals
+#define P99999 0.99999
+#define Z95 1.96
+// normal quantile of the p99.9 of the arrival the data waits for, which
+// importance sampling aims at
+#define IS_Z 3.09
 #define TIME_RANGE 10000
 #define BLOCK_RANGE 100
 #define BRATE 0.0625 // 64 out of 1024 blocks
 
 #define VISUAL_DLCMF "visual/data/bscmf"
 #define VISUAL_DLTL "visual/data/bstl"
+#define VISUAL_DLIS "visual/data/bsis"
+
+/* time bins of the records, STRSIM_TIME_AXIS overrides the default of
+ * one bin per time unit up to TIME_RANGE */
+const strsim::time_axis& report_axis(void) {
+	static const strsim::time_axis axis =
+		strsim::time_axis::from_env(TIME_RANGE);
+	return axis;
+}
 
 struct loadrecord {
-	unsigned long restore [TIME_RANGE];
-	unsigned long complete [TIME_RANGE];
-	std::vector<time_t> latency;
-	loadrecord() {
-		for (int i = 0; i < TIME_RANGE; ++i) {
-			restore[i] = complete[i] = 0;
-		}
-	}
+	strsim::cmf32 restore;
+	strsim::cmf32 complete;
+	strsim::quantile_sketch latency;
+	double decode_time;
+	// trials run, whether or not the data came back
+	unsigned long trials;
+	loadrecord() : restore(report_axis()),
+		complete(report_axis()),
+		decode_time(0), trials(0) {}
 	time_t avg_latency() {
-		time_t sumlt = 0;
-		for (time_t lt : latency) {
-			sumlt += lt;
-		}
-		return sumlt / latency.size();
+		return latency.sum() / latency.count();
+	}
+	double avg_decode_us() {
+		return decode_time * 1e6 / trials;
 	}
 	
 	loadrecord& operator+= (const loadrecord& record) {
-		for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-			this->restore[i] += record.restore[i];
-			this->complete[i] += record.complete[i];
-		}
-		this->latency.insert(
-			this->latency.end(),
-			record.latency.begin(),
-			record.latency.end()
-		);
+		this->restore += record.restore;
+		this->complete += record.complete;
+		this->latency += record.latency;
+		this->decode_time += record.decode_time;
+		this->trials += record.trials;
 		return *this;
 	}
 };
 
-unsigned int NUM_PROC = 0;
+/* Same as decoding min_coder blocks in arrival order until at most
+ * cache_size raw blocks are missing, from the order statistics only.
+ * Returns the latency, -1 if the data is never back. */
+time_t load_kofn(strsim::kofn_trial &trial, unsigned int raw_size,
+		unsigned int cache_size, loadrecord &trail) {
+	unsigned int need = (raw_size > cache_size) ? raw_size - cache_size : 1;
+	if (need > trial.size()) {
+		for (time_t atime : trial.times()) {
+			trail.restore.add(atime);
+		}
+		return -1;
+	}
+	time_t atime = trial.select(need);
+	for (unsigned int i = 0; i < need; ++i) {
+		trail.restore.add(trial.times()[i]);
+	}
+	trail.latency.add(atime);
+	trail.complete.add(atime);
+	return atime;
+}
 
-void bmsim(unsigned int raw_size, double cache_factor, unsigned int cache_count,
-		double dup_factor, unsigned int dup_count, loadrecord ** data,
-		unsigned int *arrival, unsigned int * prg) {
+/* Coder named on the command line, null if the name is unknown */
+strsim::coder * new_coder(const std::string &name) {
+	if (name == "min") {
+		return new strsim::min_coder();
+	}else if (name == "rs") {
+		return new strsim::rs_coder();
+	}else if (name == "luby") {
+		return new strsim::luby_coder(ROBUST_C, ROBUST_DELTA);
+	}
+	return nullptr;
+}
 
-	strsim::min_coder coder;
-	strsim::gaussian_generator gg(MU, SIGMA);
-	strsim::gaussian_generator gl(2*MU, 2*SIGMA);
-	
-	const unsigned int UNIT_TEST = NUM_TEST / NUM_PROC;
-
-
-	*prg = 0;
-	for (unsigned int cid = 0; cid < cache_count; ++cid) {
-		unsigned int cache_size = cid * cache_factor * raw_size;
-		for (unsigned int did = 0; did < dup_count; ++did) { 
-			unsigned int dup_size = (1 + did * dup_factor) * raw_size;
-			loadrecord trail;
-			unsigned int num_blocks = dup_size;
-			unsigned int num_bl = dup_size * BRATE;
-			
-			std::vector<strsim::coded_block *> blocks;
-			coder.encode(raw_size, num_blocks, blocks);
-		
-			/*
-			std::cout << "Load data with cache_size: " << cache_sz
-				", dup_size: " << dup_sz << std::endl;
-			*/
-			for (unsigned int i = 0; i < UNIT_TEST; ++i) {
-				for (unsigned int bid = 0; bid < num_bl; ++bid) {
-					blocks[i]->arrieve_time = gl.sample();
-				}
-				for (unsigned int bid = num_bl; bid < num_blocks; ++bid) {
-					blocks[bid]->arrieve_time = gg.sample();
-				}
-				for (auto block : blocks) {
-					if (block->arrieve_time >= TIME_RANGE) {
-						continue;
-					}
-					for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-						arrival[j]++;
-					}
-				}
-				std::sort(blocks.begin(), blocks.end(),
-					[] (strsim::coded_block* f,
-							strsim::coded_block *s) -> bool {
-						return (f->arrieve_time < s->arrieve_time);
-				});
-				coder.restart();
-				unsigned int lastleft = raw_size;
-				for (auto block : blocks) {
-					unsigned int bleft = coder.decode(block);
-					time_t atime = block->arrieve_time;
-					if (bleft < lastleft) {
-						for (time_t j = atime; j < TIME_RANGE; ++j) {
-							trail.restore[j] += lastleft - bleft;
-						}
-						lastleft = bleft;
-					}
-					if (bleft <= cache_size) {
-						trail.latency.push_back(atime);
-						for (time_t j = atime; j < TIME_RANGE; ++j) {
-							trail.complete[j]++;
-						}
-						break;
-					}
-				}
+/* Streams of the seed used by each trial */
+enum { GG_STREAM, GL_STREAM, CODER_STREAM, NUM_STREAM };
+
+/* Variance reduction of the trials */
+enum mode { PLAIN, CRN, ANTITHETIC, SOBOL, IMPORTANCE };
+
+/* Mode named on the command line, false if the name is unknown */
+bool parse_mode(const std::string &name, mode &m) {
+	const char * names[] = {"plain", "crn", "antithetic", "sobol",
+		"importance"};
+	for (int i = 0; i <= IMPORTANCE; ++i) {
+		if (name == names[i]) {
+			m = mode(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Estimates of one chunk of trials of a cell, the replicates behind
+ * the standard errors, and its weighted trials with importance
+ * sampling */
+struct chunk_estimate {
+	unsigned int count;
+	double avg_latency;
+	double tail_latency;
+	strsim::weighted_tail weighted;
+	// latencies in ascending order when a stopping rule needs them
+	std::vector<time_t> latency;
+	chunk_estimate() : count(0), avg_latency(0), tail_latency(0) {}
+};
+
+/* Mean and p99 of the latencies of a chunk, which are reordered, and
+ * the weighted trials or the sorted latencies if asked for */
+chunk_estimate estimate(std::vector<time_t> &latency,
+		const std::vector<double> &weight, bool weighted, bool keep) {
+	chunk_estimate est;
+	for (size_t i = 0; weighted && i < latency.size(); ++i) {
+		est.weighted.add(latency[i], weight[i]);
+	}
+	if (keep) {
+		est.latency = latency;
+		std::sort(est.latency.begin(), est.latency.end());
+	}
+	est.count = latency.size();
+	if (latency.empty()) {
+		return est;
+	}
+	double sum = 0;
+	for (time_t l : latency) {
+		sum += l;
+	}
+	est.avg_latency = sum / latency.size();
+	auto tail = latency.begin() + std::min(latency.size() - 1,
+		size_t(strsim::quantile_sketch::P99 * latency.size()));
+	std::nth_element(latency.begin(), tail, latency.end());
+	est.tail_latency = *tail;
+	return est;
+}
+
+/* Parameters of a sweep over the cache and duplication factors */
+struct sweep {
+	unsigned int raw_size;
+	double cache_factor;
+	unsigned int num_cache;
+	double dup_factor;
+	unsigned int num_dup;
+	std::string coder;
+	unsigned int block_size;
+	uint64_t seed;
+	mode variance;
+	double tilt;
+	// with importance sampling, the tilt of every block of each cell
+	std::vector<double> theta;
+	strsim::stopping_rule rule;
+	// data of the raw blocks when blocks carry data
+	std::vector<uint8_t> raw;
+	// verified encodings of each duplication factor, none without
+	// STRSIM_ENCODING_POOL
+	std::deque<strsim::encoding_pool> pools;
+};
+
+/* Map the pools of verified encodings of every duplication factor of
+ * a rateless sweep, from the STRSIM_ENCODING_POOL variable
+ * "dir[:count]", building in dir on the workers of pool the ones that
+ * are not there yet. False if a pool can neither be read nor built. */
+bool load_pools(sweep &s, strsim::task_pool &pool) {
+	const char * env = std::getenv("STRSIM_ENCODING_POOL");
+	strsim::coder * probe = new_coder(s.coder);
+	bool rateless = (probe->type() == RATELESS_TYPE);
+	std::string degree = rateless ?
+		static_cast<strsim::rateless_coder *>(probe)->degree() : "";
+	delete probe;
+	if (env == nullptr || !rateless) {
+		return true;
+	}
+	std::string spec(env);
+	size_t colon = spec.find(':');
+	std::string dir = spec.substr(0, colon);
+	unsigned int count = (colon == std::string::npos) ? POOL_SIZE :
+		std::stoi(spec.substr(colon + 1));
+	for (unsigned int did = 0; did < s.num_dup; ++did) {
+		unsigned int num_blocks = (1 + did * s.dup_factor) * s.raw_size;
+		s.pools.emplace_back();
+		if (num_blocks <= s.raw_size) {
+			continue;
+		}
+		std::string path = strsim::encoding_pool::file_name(dir,
+			s.raw_size, num_blocks, degree, s.seed);
+		if (s.pools.back().open(path, s.raw_size, num_blocks, degree,
+				s.seed)) {
+			continue;
+		}
+		std::cout << "Build " << path << std::endl;
+		std::string name = s.coder;
+		strsim::encoding_pool::coder_factory make = [name] () {
+			return static_cast<strsim::rateless_coder *>(new_coder(name));
+		};
+		if (!s.pools.back().build(path, make, s.raw_size, num_blocks,
+				count, s.seed, pool)) {
+			std::cerr << "Cannot write " << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* State a worker reuses from task to task and its share of the results,
+ * one record per (cache, dup) cell */
+struct worker {
+	strsim::coder * coder;
+	strsim::gaussian_generator gg;
+	strsim::gaussian_generator gl;
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block *> blocks;
+	strsim::arrival_queue queue;
+	std::vector<strsim::rnd_generator::value_type> draw;
+	strsim::kofn_trial kofn;
+	std::vector<loadrecord> data;
+	strsim::cmf arrival;
+	// latencies of the chunk being run and their weights
+	std::vector<time_t> latency;
+	std::vector<double> weight;
+	worker(const sweep &s) : coder(new_coder(s.coder)), gg(MU, SIGMA),
+			gl(2*MU, 2*SIGMA), data(s.num_cache * s.num_dup),
+			arrival(report_axis()) {
+		coder->payload(s.block_size);
+	}
+	~worker() { delete coder; }
+};
+
+/* Seed the generators of trial i of a cell, whose chunk starts at
+ * trial first, for the variance reduction of the sweep. The slow
+ * disks draw the first num_bl arrivals. */
+void seed_trial(const sweep &s, unsigned int cell, unsigned int first,
+		unsigned int i, unsigned int num_bl, worker &w) {
+	uint64_t draw = uint64_t(cell) * MAX_TEST + i;
+	if (s.variance == CRN) {
+		draw = i;
+	} else if (s.variance == ANTITHETIC) {
+		draw &= ~uint64_t(1);
+	} else if (s.variance == SOBOL) {
+		// one scrambling per chunk, the trials are its points
+		draw = uint64_t(cell) * MAX_TEST + first;
+	}
+	bool mirror = (s.variance == ANTITHETIC && (i & 1));
+	w.gg.seed(s.seed, draw * NUM_STREAM + GG_STREAM);
+	w.gl.seed(s.seed, draw * NUM_STREAM + GL_STREAM);
+	w.gg.antithetic(mirror);
+	w.gl.antithetic(mirror);
+	if (s.variance == SOBOL) {
+		// gaussian samples take two words, the fast disks start
+		// past the coordinates of the slow ones
+		w.gl.quasi(i - first);
+		w.gg.quasi(i - first, 2 * num_bl);
+	}
+}
+
+/* Likelihood ratio of the arrivals of the trial just drawn */
+double trial_weight(const worker &w) {
+	return std::exp(w.gg.log_weight() + w.gl.log_weight());
+}
+
+/* Run one chunk of CHUNK_TEST trials of a cell. Every trial draws from
+ * its own streams of the seed, and the blocks encoded for the chunk
+ * from the streams of its first trial, so the results do not depend
+ * on which worker runs a chunk nor on the number of workers. */
+void bmsim(const sweep &s, unsigned int cid, unsigned int did,
+		unsigned int chunk, worker &w, chunk_estimate &est) {
+	unsigned int raw_size = s.raw_size;
+	unsigned int cache_size = cid * s.cache_factor * raw_size;
+	unsigned int dup_size = (1 + did * s.dup_factor) * raw_size;
+	unsigned int num_blocks = dup_size;
+	loadrecord &trail = w.data[cid * s.num_dup + did];
+	if (w.coder->type() == RATELESS_TYPE && num_blocks <= raw_size) {
+		// rateless codes need more than k blocks, the encoder
+		// would never find a decodable set
+		return;
+	}
+	// min_coder without data only needs order statistics
+	bool fast = (w.coder->type() == MIN_TYPE && s.block_size == 0);
+	unsigned int num_bl = dup_size * BRATE;
+
+	double theta = (s.variance == IMPORTANCE) ?
+		s.theta[cid * s.num_dup + did] : 0;
+	w.gg.tilt(theta);
+	w.gl.tilt(theta);
+	unsigned int first = chunk * CHUNK_TEST;
+	unsigned int last = first + CHUNK_TEST;
+	unsigned int cell = cid * s.num_dup + did;
+	uint64_t code = (s.variance == CRN) ? first :
+		uint64_t(cell) * MAX_TEST + first;
+	w.coder->seed(s.seed, code * NUM_STREAM + CODER_STREAM);
+	if (!s.pools.empty()) {
+		static_cast<strsim::rateless_coder *>(w.coder)->pool(&s.pools[did]);
+	}
+	w.coder->encode(raw_size, num_blocks, w.arena, w.blocks);
+	if (s.block_size > 0) {
+		w.coder->encode_payload(s.raw.data(), w.arena);
+	}
+	w.latency.clear();
+	w.weight.clear();
+	for (unsigned int i = first; i < last; ++i) {
+		seed_trial(s, cell, first, i, num_bl, w);
+		trail.trials++;
+		if (fast) {
+			w.kofn.clear();
+			w.kofn.sample(num_bl, w.gl);
+			w.kofn.sample(num_blocks - num_bl, w.gg);
+			for (time_t atime : w.kofn.times()) {
+				w.arrival.add(atime);
+			}
+			time_t atime = load_kofn(w.kofn, raw_size, cache_size, trail);
+			if (atime >= 0) {
+				w.latency.push_back(atime);
+				w.weight.push_back(trial_weight(w));
+			}
+			continue;
+		}
+		strsim::sample_arrivals(w.gl, w.blocks.data(), num_bl, w.draw);
+		strsim::sample_arrivals(w.gg, w.blocks.data() + num_bl,
+				num_blocks - num_bl, w.draw);
+		for (auto block : w.blocks) {
+			w.arrival.add(block->arrieve_time);
+		}
+		w.queue.assign(w.blocks.data(), w.blocks.size());
+		w.coder->restart();
+		unsigned int lastleft = raw_size;
+		while (!w.queue.empty()) {
+			strsim::coded_block * block = w.queue.pop();
+			// the clock costs about as much as a peeling step, only
+			// the decoding of real data is timed
+			std::chrono::steady_clock::time_point start;
+			if (s.block_size > 0) {
+				start = std::chrono::steady_clock::now();
+			}
+			unsigned int bleft = w.coder->decode(block);
+			if (s.block_size > 0) {
+				trail.decode_time += std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			}
+			time_t atime = block->arrieve_time;
+			if (bleft < lastleft) {
+				trail.restore.add(atime, lastleft - bleft);
+				lastleft = bleft;
 			}
-			data[cid][did] = trail;
-			for (auto block : blocks) {
-				delete block;
+			if (bleft <= cache_size) {
+				trail.latency.add(atime);
+				trail.complete.add(atime);
+				w.latency.push_back(atime);
+				w.weight.push_back(trial_weight(w));
+				break;
 			}
 		}
-		(*prg)++;
+	}
+	est = estimate(w.latency, w.weight, s.variance == IMPORTANCE,
+		s.rule.active() && s.rule.quantile() > 0);
+}
+
+/* Relative half-width of the confidence interval of the metric of
+ * the stopping rule over the first chunks of a cell, nan when none of
+ * their trials completes */
+double half_width(const sweep &s, const chunk_estimate * chunk,
+		unsigned int chunks) {
+	const strsim::stopping_rule &rule = s.rule;
+	const double inf = std::numeric_limits<double>::infinity();
+	double est, lo, hi;
+	if (s.variance == IMPORTANCE) {
+		strsim::weighted_tail weighted;
+		for (unsigned int c = 0; c < chunks; ++c) {
+			weighted += chunk[c].weighted;
+		}
+		if (weighted.empty()) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+		if (weighted.count() < 2 ||
+				weighted.effective_size() < MIN_EFFECTIVE) {
+			return inf;
+		}
+		if (rule.quantile() == 0) {
+			est = weighted.mean();
+			lo = est - rule.z() * weighted.std_error();
+			hi = est + rule.z() * weighted.std_error();
+		} else {
+			est = weighted.quantile(rule.quantile());
+			weighted.interval(rule.quantile(), rule.z(), lo, hi);
+		}
+	} else if (rule.quantile() == 0) {
+		// chunks are the replicates, whatever the mode
+		strsim::replicates avg;
+		for (unsigned int c = 0; c < chunks; ++c) {
+			if (chunk[c].count > 0) {
+				avg.add(chunk[c].avg_latency);
+			}
+		}
+		if (avg.count() == 0) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+		if (avg.count() < 2) {
+			return inf;
+		}
+		est = avg.mean();
+		lo = est - rule.z() * avg.std_error();
+		hi = est + rule.z() * avg.std_error();
+	} else {
+		std::vector<time_t> sorted;
+		for (unsigned int c = 0; c < chunks; ++c) {
+			size_t mid = sorted.size();
+			sorted.insert(sorted.end(), chunk[c].latency.begin(),
+				chunk[c].latency.end());
+			std::inplace_merge(sorted.begin(), sorted.begin() + mid,
+				sorted.end());
+		}
+		if (sorted.empty()) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+		strsim::stopping_rule::order_interval(sorted, rule.quantile(),
+			rule.z(), est, lo, hi);
+	}
+	return strsim::stopping_rule::relative(est, lo, hi);
+}
+
+/* Tilt of every block of each cell for importance sampling: the sum of
+ * the arrival times shifts as far as minimises the variance for the
+ * p99.9 of the arrival the data waits for, at most s.tilt standard
+ * deviations */
+void aim_tilts(sweep &s) {
+	s.theta.assign(s.num_cache * s.num_dup, 0);
+	for (unsigned int cid = 0; cid < s.num_cache; ++cid) {
+		for (unsigned int did = 0; did < s.num_dup; ++did) {
+			unsigned int cache_size = cid * s.cache_factor * s.raw_size;
+			unsigned int num_blocks = (1 + did * s.dup_factor) *
+				s.raw_size;
+			unsigned int need = (s.raw_size > cache_size) ?
+				s.raw_size - cache_size : 1;
+			// num_bl of the blocks are on slow disks
+			double slow = double(unsigned(num_blocks * BRATE)) /
+				num_blocks;
+			std::vector<strsim::normal_part> mix = {
+				{slow, 2*MU, 2*SIGMA}, {1 - slow, MU, SIGMA}};
+			double rho = strsim::order_correlation(mix,
+				std::min(need, num_blocks), num_blocks);
+			s.theta[cid * s.num_dup + did] =
+				strsim::importance_shift(rho, IS_Z, s.tilt) /
+				std::sqrt(double(num_blocks));
+		}
 	}
 }
 
 int main(int argc, char ** argv) {
-	if (argc != 6) {
-		std::cerr << "Usage: simplesim [raw_size] " <<
+	if (argc < 6 || argc > 13) {
+		std::cerr << "Usage: bssim [raw_size] " <<
 			"[cache_factor] [max_cachefactor] " <<
-			"[dup_factor] [num_dupfactor]" << std::endl;
+			"[dup_factor] [num_dupfactor] [min|rs|luby] " <<
+			"[block_size] [workers] [seed] " <<
+			"[plain|crn|antithetic|sobol|importance] [tilt] " <<
+			"[metric:half_width[:confidence]]" << std::endl;
 		return 1;
 	}
 	
@@ -157,76 +561,143 @@ int main(int argc, char ** argv) {
 	const double MAX_CACHE = std::stod(argv[3]);
 	const double DUP_FACTOR = std::stod(argv[4]);
 	const double MAX_DUP = std::stod(argv[5]);
+	const std::string CODER = (argc > 6) ? argv[6] : "min";
+	const unsigned int BLOCK_SIZE = (argc > 7) ? std::stoi(argv[7]) : 0;
+	const unsigned int WORKERS = (argc > 8) ? std::stoi(argv[8]) : 0;
+	const uint64_t SEED = (argc > 9) ? std::stoull(argv[9], nullptr, 0) :
+		strsim::global_seed();
+	const std::string MODE = (argc > 10) ? argv[10] : "plain";
+	const double TILT = (argc > 11) ? std::stod(argv[11]) : 1;
+	const std::string STOP = (argc > 12) ? argv[12] : "";
 
 	unsigned int num_cache = MAX_CACHE / CACHE_FACTOR + 1;
 	unsigned int num_dup = MAX_DUP / DUP_FACTOR + 1;
 
-	NUM_PROC = std::thread::hardware_concurrency() / 2;
-	std::cout << "Number of processors: " << NUM_PROC << std::endl;
+	strsim::coder * check = new_coder(CODER);
+	if (check == nullptr) {
+		std::cerr << "Unknown coder " << CODER << std::endl;
+		return 1;
+	}
+	delete check;
+	mode variance;
+	if (!parse_mode(MODE, variance)) {
+		std::cerr << "Unknown mode " << MODE << std::endl;
+		return 1;
+	}
+	strsim::stopping_rule rule;
+	if (!STOP.empty() && !rule.parse(STOP)) {
+		std::cerr << "Bad stopping rule " << STOP << std::endl;
+		return 1;
+	}
+	if (CODER == "rs" && (unsigned int)((1 + (num_dup - 1) * DUP_FACTOR) *
+			RAW_SIZE) > strsim::rs_coder::MAX_BLOCKS) {
+		std::cerr << "rs codes hold at most " <<
+			strsim::rs_coder::MAX_BLOCKS << " blocks" << std::endl;
+		return 1;
+	}
+
+	strsim::task_pool pool(WORKERS);
+	std::cout << "Number of workers: " << pool.workers() << std::endl;
+	std::cout << "Seed: " << SEED << std::endl;
+	std::cout << "Mode: " << MODE << std::endl;
+	strsim::global_seed(SEED);
+
+	sweep s = {RAW_SIZE, CACHE_FACTOR, num_cache, DUP_FACTOR, num_dup,
+		CODER, BLOCK_SIZE, SEED, variance, TILT, std::vector<double>(),
+		rule,
+		std::vector<uint8_t>()};
+	s.raw.resize(size_t(RAW_SIZE) * BLOCK_SIZE);
+	if (variance == IMPORTANCE) {
+		aim_tilts(s);
+	}
+	if (!load_pools(s, pool)) {
+		return 1;
+	}
+	std::mt19937 rng;
+	for (auto &b : s.raw) {
+		b = rng();
+	}
 
 	/* Initialize space for putting results */
-	loadrecord *** data = new loadrecord ** [NUM_PROC];
-	unsigned int * prg = new unsigned int [NUM_PROC];
-	unsigned int ** arrival = new unsigned int * [NUM_PROC];
-	for (unsigned int i = 0; i < NUM_PROC; ++i) {
-		data[i] = new loadrecord * [num_cache];
-		for (unsigned int j = 0; j < num_cache; ++j) {
-			data[i][j] = new loadrecord [num_dup];
-		}
-		arrival[i] = new unsigned int [TIME_RANGE];
+	std::vector<worker *> workers;
+	for (unsigned int i = 0; i < pool.workers(); ++i) {
+		workers.push_back(new worker(s));
 	}
 	std::cout << "Run simulation" << std::endl;
-	
-	std::thread * processors = new std::thread [NUM_PROC];
-	for (unsigned int i = 0; i < NUM_PROC; ++i) {
-		processors[i] = std::thread(bmsim, RAW_SIZE, CACHE_FACTOR, num_cache,
-				DUP_FACTOR, num_dup, data[i], arrival[i], &prg[i]);
-	}
 
-	bool done = false;
-	unsigned int min_prg = 0;
-	if (num_cache <= 1){
-		done = true;
+	// cells differ a lot in cost, so they are split into chunks of
+	// trials that idle workers steal. Without a stopping rule every
+	// cell runs its NUM_TEST trials in one round, with one the open
+	// cells run ROUND_CHUNK more chunks a round until they meet the
+	// target or reach MAX_TEST trials.
+	const unsigned int num_cell = num_cache * num_dup;
+	const unsigned int num_chunk = (rule.active() ? MAX_TEST : NUM_TEST) /
+		CHUNK_TEST;
+	const unsigned int round_chunk = rule.active() ? ROUND_CHUNK : num_chunk;
+	// estimates of every chunk, num_chunk per cell
+	std::vector<chunk_estimate> estimates(num_cell * num_chunk);
+	// chunks run and relative half-width of the metric of each cell
+	std::vector<unsigned int> chunks(num_cell, 0);
+	std::vector<double> width(num_cell,
+		std::numeric_limits<double>::quiet_NaN());
+	std::vector<unsigned int> open;
+	for (unsigned int cell = 0; cell < num_cell; ++cell) {
+		open.push_back(cell);
 	}
-	
-	while (!done) {
-		unsigned int mprg = num_cache;
-		for(unsigned int i = 0; i < NUM_PROC; ++i) {
-			if (prg[i] < mprg) {
-				mprg = prg[i];
+	for (unsigned int round = 1, last = num_cell; !open.empty(); ++round) {
+		std::vector<unsigned int> tasks;
+		for (unsigned int cell : open) {
+			unsigned int end = std::min(chunks[cell] + round_chunk,
+				num_chunk);
+			for (unsigned int c = chunks[cell]; c < end; ++c) {
+				tasks.push_back(cell * num_chunk + c);
 			}
+			chunks[cell] = end;
+		}
+		unsigned int reported = 0;
+		pool.run(tasks.size(),
+			[&] (unsigned int id, unsigned int w) {
+				unsigned int cell = tasks[id] / num_chunk;
+				bmsim(s, cell / num_dup, cell % num_dup,
+					tasks[id] % num_chunk, *workers[w],
+					estimates[tasks[id]]);
+			},
+			[&] (unsigned int done) {
+				unsigned int percent = uint64_t(done) * 100 / tasks.size();
+				if (!rule.active() && percent / 10 > reported / 10) {
+					reported = percent;
+					std::cout << "Progress: " << percent << "%" << std::endl;
+				}
+			});
+		if (!rule.active()) {
+			break;
 		}
-		if (mprg > min_prg) {
-			min_prg = mprg;
-			std::cout << "Progress: " <<
-				(double)min_prg / (double)num_cache * 100 <<
-				"%" << std::endl;
+		std::vector<unsigned int> still;
+		for (unsigned int cell : open) {
+			width[cell] = half_width(s, &estimates[cell * num_chunk],
+				chunks[cell]);
+			// cells where no trial completes have nothing to refine
+			if (!std::isnan(width[cell]) && !rule.met(width[cell]) &&
+					chunks[cell] < num_chunk) {
+				still.push_back(cell);
+			}
 		}
-		if (min_prg == num_cache - 1) {
-			done = true;
-		}else{
-			std::this_thread::sleep_for(
-				std::chrono::milliseconds(1000)
-			);
+		open.swap(still);
+		if (open.size() != last) {
+			last = open.size();
+			std::cout << "Round " << round << ": " << last <<
+				" settings above the target" << std::endl;
 		}
 	}
 
-	for (unsigned int i = 0; i < NUM_PROC; ++i) {
-		processors[i].join();
-	}
-	delete [] processors;
-
 	/* Calculate results */
-	for (unsigned int i = 1; i < NUM_PROC; ++i) {
-		for (unsigned int j = 0; j < num_cache; ++j) {
-			for (unsigned int k = 0; k < num_dup; ++k) {
-				data[0][j][k] += data[i][j][k];
-			}
-		}
-		for (unsigned int j = 0; j < TIME_RANGE; ++j) {
-			arrival[0][j] += arrival[i][j];
+	std::vector<loadrecord> &data = workers[0]->data;
+	for (unsigned int i = 1; i < workers.size(); ++i) {
+		for (unsigned int j = 0; j < data.size(); ++j) {
+			data[j] += workers[i]->data[j];
 		}
-	} 
+		workers[0]->arrival += workers[i]->arrival;
+	}
 
 	std::ofstream report_cmf(VISUAL_DLCMF);
 	report_cmf << "Time,Arrival,";
@@ -235,54 +706,129 @@ int main(int argc, char ** argv) {
 			report_cmf <<
 				"C=" << (i*CACHE_FACTOR) << "N-" << 
 				"K=" << (j*DUP_FACTOR) << "N,";
-			std::sort(
-				data[0][i][j].latency.begin(),
-				data[0][i][j].latency.end()
-			);
 		}
 	}
 	report_cmf << std::endl;
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[0][i]) /
-			double(arrival[0][TIME_RANGE-1]) << ",";
-		for (unsigned int cid = 0; cid < num_cache; ++cid) {
-			for (unsigned int did = 0; did < num_dup; ++did) {
-				report_cmf <<
-					double(data[0][cid][did].complete[i]) /
-					double(data[0][cid][did].complete[TIME_RANGE-1]) << ",";
-			}
+	std::vector<double> arrived = workers[0]->arrival.distribution();
+	std::vector<std::vector<double> > completed;
+	for (unsigned int cid = 0; cid < num_cache; ++cid) {
+		for (unsigned int did = 0; did < num_dup; ++did) {
+			completed.push_back(
+				data[cid * num_dup + did].complete.distribution());
+		}
+	}
+	const strsim::time_axis &axis = report_axis();
+	for (unsigned int b = 0; b < axis.bins(); ++b) {
+		report_cmf << double(axis.last(b)) / 1000 << "," <<
+			arrived[b] << ",";
+		for (auto& complete : completed) {
+			report_cmf << complete[b] << ",";
 		}
 		report_cmf << std::endl;
 	}
 	
 	std::ofstream report_dl(VISUAL_DLTL);
-	unsigned tid = NUM_TEST / 100 * 99;
-	report_dl << "C,K,avg_latency,tail_latency" << std::endl;
+	report_dl << "C,K,avg_latency,tail_latency,avg_decode_us," <<
+		strsim::quantile_sketch::percentile_header() <<
+		",se_avg_latency,se_tail_latency,diff_avg_latency," <<
+		"se_diff_avg_latency,trials,rel_half_width" << std::endl;
 	for (unsigned int i = 0; i < num_cache; ++i) {
 		for (unsigned int j = 0; j < num_dup; ++j) {
-			report_dl << i*CACHE_FACTOR << "," << j*DUP_FACTOR << "," <<
-				data[0][i][j].avg_latency() << "," <<
-				data[0][i][j].latency[tid] << "," << std::endl;
+			loadrecord &record = data[i * num_dup + j];
+			report_dl << i*CACHE_FACTOR << "," << j*DUP_FACTOR << ",";
+			if (record.latency.empty()) {
+				report_dl << "nan,nan,nan,nan,nan,nan,nan,nan," <<
+					"nan,nan,nan,nan," << chunks[i * num_dup + j] *
+					CHUNK_TEST << ",nan" << std::endl;
+				continue;
+			}
+			report_dl << record.avg_latency() << "," <<
+				record.latency.quantile(strsim::quantile_sketch::P99) <<
+				"," << ((BLOCK_SIZE > 0) ? record.avg_decode_us() :
+				std::numeric_limits<double>::quiet_NaN()) << ",";
+			record.latency.write_percentiles(report_dl);
+			// chunks are the replicates, the difference to the cell
+			// without cache pairs chunks of the same trials
+			unsigned int cell = i * num_dup + j;
+			strsim::replicates avg, tail, diff;
+			for (unsigned int c = 0; c < chunks[cell]; ++c) {
+				chunk_estimate &est = estimates[cell * num_chunk + c];
+				if (est.count == 0) {
+					continue;
+				}
+				avg.add(est.avg_latency);
+				tail.add(est.tail_latency);
+				if (c < chunks[j] && estimates[j * num_chunk + c].count > 0) {
+					diff.add(est.avg_latency -
+						estimates[j * num_chunk + c].avg_latency);
+				}
+			}
+			report_dl << "," << avg.std_error() << "," <<
+				tail.std_error() << "," << diff.mean() << "," <<
+				diff.std_error() << "," << chunks[cell] * CHUNK_TEST <<
+				"," << width[cell] << std::endl;
 		}
 	}
 
 	report_cmf.close();
 	report_dl.close();
-	
-	for (unsigned int i = 0; i < NUM_PROC; ++i) {
-		for (unsigned int j = 0; j < num_cache; ++j) {
-			delete [] data[i][j];
+
+	if (variance == IMPORTANCE) {
+		std::ofstream report_is(VISUAL_DLIS);
+		const double level[] = {strsim::quantile_sketch::P99,
+			strsim::quantile_sketch::P999, strsim::quantile_sketch::P9999,
+			P99999};
+		const char * name[] = {"p99", "p99.9", "p99.99", "p99.999"};
+		report_is << "C,K,shift,trials,effective_trials,avg_latency," <<
+			"se_avg_latency";
+		for (auto n : name) {
+			report_is << "," << n << "," << n << "_lo," << n << "_hi";
 		}
-		delete [] data[i];
-		delete [] arrival[i];
+		report_is << std::endl;
+		for (unsigned int i = 0; i < num_cache; ++i) {
+			for (unsigned int j = 0; j < num_dup; ++j) {
+				strsim::weighted_tail weighted;
+				unsigned int cell = i * num_dup + j;
+				for (unsigned int c = 0; c < chunks[cell]; ++c) {
+					weighted += estimates[cell * num_chunk + c].weighted;
+				}
+				unsigned int num_blocks = (1 + j * DUP_FACTOR) * RAW_SIZE;
+				double shift = s.theta[i * num_dup + j] *
+					std::sqrt(double(num_blocks));
+				report_is << i*CACHE_FACTOR << "," << j*DUP_FACTOR <<
+					"," << shift << "," << weighted.count();
+				if (weighted.count() < 2) {
+					report_is << ",nan,nan,nan,nan,nan,nan,nan,nan,nan," <<
+						"nan,nan,nan,nan,nan" << std::endl;
+					continue;
+				}
+				report_is << "," << weighted.effective_size();
+				if (weighted.effective_size() < MIN_EFFECTIVE) {
+					// too few trials carry the weight to trust any
+					// estimate
+					std::cerr << "C=" << i*CACHE_FACTOR << ",K=" <<
+						j*DUP_FACTOR << ": only " <<
+						weighted.effective_size() << " effective " <<
+						"trials, lower the tilt" << std::endl;
+					report_is << ",nan,nan,nan,nan,nan,nan,nan,nan,nan," <<
+						"nan,nan,nan,nan" << std::endl;
+					continue;
+				}
+				report_is << "," << weighted.mean() << "," <<
+					weighted.std_error();
+				for (double q : level) {
+					double lo, hi;
+					weighted.interval(q, Z95, lo, hi);
+					report_is << "," << weighted.quantile(q) << "," <<
+						lo << "," << hi;
+				}
+				report_is << std::endl;
+			}
+		}
+		report_is.close();
 	}
-	delete [] data;
-	delete [] prg;
-	delete [] arrival;
-
-
-	
 
+	for (auto w : workers) {
+		delete w;
+	}
 }
-
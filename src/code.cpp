@@ -1,48 +1,100 @@
 #include "code.h"
+#include "encpool.h"
+#include "simd.h"
 #include "iostream"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <cstring>
+#include <stdexcept>
 
-void strsim::soliton_generator::setup(
-		strsim::rnd_generator::value_type seed) {
-	using value_type = strsim::rnd_generator::value_type;
-	// build the distribution table
-	if (_size >= seed + 1) {
-		return;
+void strsim::alias_table::build(const std::vector<double> &weights) {
+	size_type n = weights.size();
+	double total = 0;
+	for (double w : weights) {
+		total += w;
 	}
-	if (_cdf != nullptr) {
-		delete[] _cdf;
+	_prob.resize(n);
+	_alias.resize(n);
+	_small.clear();
+	_large.clear();
+	// scale weights so that the average column holds exactly 1
+	for (size_type i = 0; i < n; ++i) {
+		_prob[i] = weights[i] * n / total;
+		_alias[i] = i;
+		if (_prob[i] < 1.0) {
+			_small.push_back(i);
+		}else{
+			_large.push_back(i);
+		}
 	}
-	_size = seed + 1;
-	_cdf = new double [seed + 1];
-	_cdf[0] = 0;
-	_cdf[1] = 1.0 / seed;
-	for (value_type i = 2; i <= seed; ++i) {
-		_cdf[i] = _cdf[i-1] + 1.0 / (i * (i-1));
+	// fill every small column with the excess of a large one
+	while (!_small.empty() && !_large.empty()) {
+		size_type s = _small.back();
+		size_type l = _large.back();
+		_small.pop_back();
+		_alias[s] = l;
+		_prob[l] -= 1.0 - _prob[s];
+		if (_prob[l] < 1.0) {
+			_large.pop_back();
+			_small.push_back(l);
+		}
+	}
+	// what is left is full up to rounding errors
+	for (size_type i : _small) {
+		_prob[i] = 1.0;
 	}
-	/*
-	for (value_type i = 0; i <= seed; ++i) {
-		DBG(_cdf[i]);
+	for (size_type i : _large) {
+		_prob[i] = 1.0;
 	}
-	*/
 }
 
-strsim::rnd_generator::value_type strsim::soliton_generator::sample() {
+void strsim::soliton_generator::weights(
+		strsim::rnd_generator::value_type k, std::vector<double> &w) {
 	using value_type = strsim::rnd_generator::value_type;
-	double seed = _dist(_gen);
-	// search for seed over cdf using binary search
-	value_type f = 0;
-	value_type l = _size - 1;
-	while (f < l) {
-		value_type m = (f + l) / 2;
-		if (_cdf[m] <= seed && seed < _cdf[m+1]) {
-			return m + 1;
-		}else if (_cdf[m] > seed) {
-			l = m - 1;
-		}else{
-			f = m + 1;
-		}
+	w.assign(k, 0);
+	w[0] = 1.0 / k;
+	for (value_type i = 2; i <= k; ++i) {
+		w[i-1] = 1.0 / (double(i) * (i-1));
+	}
+}
+
+void strsim::robust_soliton_generator::weights(
+		strsim::rnd_generator::value_type k, std::vector<double> &w) {
+	using value_type = strsim::rnd_generator::value_type;
+	soliton_generator::weights(k, w);
+	double r = _c * std::log(k / _delta) * std::sqrt(double(k));
+	value_type spike = (r > 0) ? value_type(k / r) : k;
+	if (spike < 1) {
+		spike = 1;
+	}else if (spike > k) {
+		spike = k;
+	}
+	for (value_type i = 1; i < spike; ++i) {
+		w[i-1] += r / (double(i) * k);
+	}
+	if (r > _delta) {
+		w[spike-1] += r * std::log(r / _delta) / k;
+	}
+}
+
+std::string strsim::robust_soliton_generator::name(void) const {
+	std::ostringstream name;
+	name << "robust-" << _c << "-" << _delta;
+	return name.str();
+}
+
+void strsim::soliton_generator::setup(
+		strsim::rnd_generator::value_type seed) {
+	// build the distribution table, only if the number of raw blocks
+	// changed since it is called on every encoding
+	if (_size == seed) {
+		return;
 	}
-	//DBG(f+1);
-	return l + 1;
+	_size = seed;
+	weights(seed, _weights);
+	_table.build(_weights);
 }
 
 void strsim::uniform_generator::setup(
@@ -56,37 +108,149 @@ strsim::rnd_generator::value_type strsim::uniform_generator::sample() {
 }
 
 
+const strsim::gf2_basis::size_type strsim::gf2_basis::NO_ROW;
+
+void strsim::gf2_basis::reset(size_type columns, size_t payload) {
+	_columns = columns;
+	_words = (columns + 63) / 64;
+	_rank = 0;
+	_size = payload;
+	_rows.clear();
+	_rows.reserve(size_t(_words) * columns);
+	_payloads.clear();
+	_payloads.reserve(_size * columns);
+	_pivot.assign(columns, NO_ROW);
+	_scratch.resize(_words);
+	_payload_scratch.resize(_size);
+}
+
+strsim::gf2_basis::word_type * strsim::gf2_basis::row(void) {
+	for (size_type i = 0; i < _words; ++i) {
+		_scratch[i] = 0;
+	}
+	if (_size > 0) {
+		memset(_payload_scratch.data(), 0, _size);
+	}
+	return _scratch.data();
+}
+
+bool strsim::gf2_basis::insert(void) {
+	word_type * row = _scratch.data();
+	for (size_type w = 0; w < _words; ++w) {
+		while (row[w] != 0) {
+			size_type column = w * 64 + __builtin_ctzll(row[w]);
+			if (_pivot[column] == NO_ROW) {
+				// a new pivot, keep the row
+				_pivot[column] = _rank++;
+				_rows.insert(_rows.end(), row, row + _words);
+				_payloads.insert(_payloads.end(), _payload_scratch.begin(),
+						_payload_scratch.end());
+				return true;
+			}
+			// the pivot row has no column before this one so the
+			// words before w are already zero on both sides
+			const word_type * pivot = _rows.data() +
+				size_t(_pivot[column]) * _words;
+			for (size_type i = w; i < _words; ++i) {
+				row[i] ^= pivot[i];
+			}
+			if (_size > 0) {
+				xor_block(_payload_scratch.data(), _payloads.data() +
+						_pivot[column] * _size, _size);
+			}
+		}
+	}
+	return false;
+}
+
+void strsim::gf2_basis::solve(uint8_t * out) const {
+	// every row only has columns after its pivot, so solve them from
+	// the last column back
+	for (size_type column = _columns; column-- > 0; ) {
+		size_t r = _pivot[column];
+		const word_type * row = _rows.data() + r * _words;
+		uint8_t * value = out + column * _size;
+		memcpy(value, _payloads.data() + r * _size, _size);
+		for (size_type w = column / 64; w < _words; ++w) {
+			word_type bits = row[w];
+			if (w == column / 64) {
+				// drop the pivot and the columns before it
+				bits &= ~word_type(0) << (column % 64) << 1;
+			}
+			while (bits != 0) {
+				size_type other = w * 64 + __builtin_ctzll(bits);
+				bits &= bits - 1;
+				xor_block(value, out + size_t(other) * _size, _size);
+			}
+		}
+	}
+}
+
+const strsim::rateless_coder::size_type strsim::rateless_coder::NO_EDGE;
+
+// grow a vector to hold n elements, with room to spare so that
+// encodings of slightly different sizes do not reallocate it again
+template <typename T>
+static void reserve_for(std::vector<T> &v, size_t n) {
+	if (v.capacity() < n) {
+		v.reserve(2 * n);
+	}
+}
+
 void strsim::rateless_coder::encode(unsigned int inum, unsigned int onum,
-		std::vector<strsim::coded_block *> &b) {
+		strsim::block_arena &arena, std::vector<strsim::coded_block *> &b) {
 	using value_type = strsim::rateless_block::value_type;
 	bool finished = false;
 	_gen->setup(inum);
-	std::random_device rd;
-	std::mt19937 rden(rd());
-	std::uniform_int_distribution<unsigned int> dist(0, inum - 1);
+	_subset.reset(inum);
 	_num_blocks = inum;
-	_raw_table.clear();
-	for (unsigned int i = 0; i < inum; ++i) {
-		_raw_table.push_back(false);
+	_num_coded = onum;
+	_raw_table.assign(inum, false);
+	_head.assign(inum, NO_EDGE);
+	reserve_for(_degree, onum);
+	reserve_for(_residual, onum);
+	reserve_for(_ripple, inum);
+	rateless_encoding &encoding = arena.encoding;
+	rateless_block * blocks = arena.rateless_blocks(onum);
+	if (_block_size > 0) {
+		arena.payload.resize(size_t(onum) * _block_size);
+		_data.resize(size_t(inum) * _block_size);
+	}
+	b.clear();
+	for (unsigned int i = 0; i < onum; ++i) {
+		blocks[i].encoding = &encoding;
+		blocks[i].index = i;
+		blocks[i].payload = (_block_size > 0) ?
+			arena.payload.data() + size_t(i) * _block_size : nullptr;
+		b.push_back(&blocks[i]);
+	}
+	if (_pool != nullptr && _pool->matches(inum, onum)) {
+		// already checked, only the names of the raw blocks change
+		_label.resize(inum);
+		std::iota(_label.begin(), _label.end(), 0);
+		std::shuffle(_label.begin(), _label.end(), _rng);
+		std::uniform_int_distribution<size_type> pick(0, _pool->size() - 1);
+		_pool->draw(pick(_rng), _label.data(), encoding);
+		reserve_for(_edge_block, encoding.num_edges());
+		reserve_for(_edge_next, encoding.num_edges());
+		this->restart();
+		finished = true;
 	}
+	// the data is not there yet, check the encoding without it
+	size_type block_size = _block_size;
+	_block_size = 0;
 	while (!finished) {
-		b.clear(); // prepare for new blocks
+		encoding.reset(inum); // prepare for new blocks
 		for (unsigned int i = 0; i < onum; ++i) {
-			rateless_block * block = new rateless_block();
 			value_type num_raw_blocks = _gen->sample();
-			for (unsigned int i = 0; i < num_raw_blocks; ++i) {
-				value_type raw = dist(rden);
-				while (_raw_table[raw]) {
-					raw = (raw + 1) % inum;
-				}
-				block->raw_blocks.push_back(raw);
-				_raw_table[raw] = true;
-			}
-			b.push_back(block);
-			for (auto raw : block->raw_blocks) {
-				_raw_table[raw] = false;
-			}
+			_subset.sample(num_raw_blocks, _rng, [&] (value_type raw) {
+				encoding.push_raw(raw);
+			});
+			encoding.close_block();
 		}
+		// decoding never needs more edges than the encoding has
+		reserve_for(_edge_block, encoding.num_edges());
+		reserve_for(_edge_next, encoding.num_edges());
 		//break;
 		// check again to make sure that we could  restore the raw data
 		// from coded blocks
@@ -99,80 +263,336 @@ void strsim::rateless_coder::encode(unsigned int inum, unsigned int onum,
 		}
 		this->restart();
 	}
+	_block_size = block_size;
+	size_work();
+}
+
+void strsim::rateless_coder::encode_payload(const uint8_t * raw,
+		strsim::block_arena &arena) {
+	const rateless_encoding &encoding = arena.encoding;
+	for (size_type i = 0; i < encoding.size(); ++i) {
+		uint8_t * out = arena.payload.data() + size_t(i) * _block_size;
+		memset(out, 0, _block_size);
+		encoding.for_each(i, [&] (value_type r) {
+			xor_block(out, raw + size_t(r) * _block_size, _block_size);
+		});
+	}
+}
+
+void strsim::rateless_coder::recover(value_type raw) {
+	_raw_table[raw] = true;
+	_num_recovered++;
+	_ripple.push_back(raw);
+	if (_eliminating) {
+		_solved.push_back(raw);
+	}
+	DBG("Block " << raw << " recovered");
+}
+
+void strsim::rateless_coder::propagate(void) {
+	// use blocks that have just recovered for decoding other blocks,
+	// each coded block is visited once per raw block it covers
+	while (!_ripple.empty()) {
+		value_type raw = _ripple.back();
+		_ripple.pop_back();
+		for (size_type e = _head[raw]; e != NO_EDGE; e = _edge_next[e]) {
+			size_type id = _edge_block[e];
+			if (_degree[id] == 0) {
+				continue;
+			}
+			_residual[id] ^= raw;
+			if (_block_size > 0) {
+				xor_block(work(id), _data.data() + size_t(raw) * _block_size,
+						_block_size);
+			}
+			if (--_degree[id] == 1) {
+				// only one raw block left, it is fully decoded
+				value_type b = _residual[id];
+				_degree[id] = 0;
+				_num_pending--;
+				if (!_raw_table[b]) {
+					if (_block_size > 0) {
+						memcpy(_data.data() + size_t(b) * _block_size,
+								work(id), _block_size);
+					}
+					recover(b);
+				}
+			}
+		}
+		_head[raw] = NO_EDGE;
+	}
 }
 
 unsigned int strsim::rateless_coder::decode(strsim::coded_block * b) {
 	if (b->type() != this->type()) {
 		DBG("The type of the coded is unknown");
 	}
-	std::list<value_type> block =
-		(static_cast<rateless_block*>(b))->raw_blocks;
-	if (block.size() > 1) {
-		// check if we could reduce the regree of the block
-		for (	auto encoded_block = block.begin();
-				encoded_block != block.end(); ) {
-			bool manual = true;
-			for (auto decoded_block : _raw_queue) {
-				if (*encoded_block == decoded_block) {
-					encoded_block = block.erase(encoded_block);
-					manual = false;
-					break;
-				}
-			}
-			if (manual) {
-				encoded_block++;
+	const rateless_block * block = static_cast<rateless_block*>(b);
+	// reduce the degree of the block by raw blocks we already have
+	size_type degree = 0;
+	value_type residual = 0;
+	block->for_each([&] (value_type raw) {
+		if (!_raw_table[raw]) {
+			degree++;
+			residual ^= raw;
+		}
+	});
+	if (degree > 0 && _block_size > 0) {
+		// strip the raw blocks we already have from the data as well
+		uint8_t * out = (degree == 1) ?
+			_data.data() + size_t(residual) * _block_size :
+			work(_degree.size());
+		memcpy(out, block->payload, _block_size);
+		block->for_each([&] (value_type raw) {
+			if (_raw_table[raw]) {
+				xor_block(out, _data.data() + size_t(raw) * _block_size,
+						_block_size);
 			}
-		}	
+		});
 	}
-	std::list<value_type> buffer;
-	if (block.size() > 1) {
+	if (degree == 1) {
+		// the block is fully decoded so we use it for decoding others
+		recover(residual);
+		propagate();
+	}else if (degree > 1) {
 		// if the degree of the block is still greater than 1 then
-		// we put it on waiting list
-		_coding_queue.push_back(block);
-	}else if (block.size() == 1 && !_raw_table[block.front()]) {
-		// the block is fully decoded so we put it on raw list
-		// and use it for decoding other block
-		value_type raw = block.front();
-		_raw_queue.push_back(raw);
-		_raw_table[raw] = true;
-		buffer.push_back(raw);
-		DBG("Block " << raw << " recovered");
-	}
-	// used block that has just recovered for decoding other blocks
-	while (!buffer.empty()) {
-		value_type raw = buffer.front();
-		buffer.pop_front();
-		for (	auto decoded_block = _coding_queue.begin();
-			   	decoded_block != _coding_queue.end(); ) {
-			for (	auto encoded_block = decoded_block->begin();
-					encoded_block != decoded_block->end(); ) {
-				if (raw == *encoded_block) {
-					encoded_block = decoded_block->erase(encoded_block);
-				}else{
-					encoded_block++;
-				}
+		// we put it on waiting list of its remaining raw blocks
+		size_type id = _degree.size();
+		_degree.push_back(degree);
+		_residual.push_back(residual);
+		_pending.push_back(block);
+		_num_pending++;
+		block->for_each([&] (value_type raw) {
+			if (!_raw_table[raw]) {
+				_edge_block.push_back(id);
+				_edge_next.push_back(_head[raw]);
+				_head[raw] = _edge_block.size() - 1;
+			}
+		});
+	}
+	eliminate(degree > 1 ? block : nullptr);
+	return _num_blocks - _num_recovered;
+}
+
+void strsim::rateless_coder::add_column(gf2_basis::word_type * row,
+		uint8_t * payload, value_type raw) {
+	if (_state[raw] == INACTIVE) {
+		_basis.set(row, _slot[raw]);
+	}else if (_state[raw] == SOLVED) {
+		const gf2_basis::word_type * expr =
+			_expr.data() + size_t(_slot[raw]) * _basis.words();
+		for (size_type i = 0; i < _basis.words(); ++i) {
+			row[i] ^= expr[i];
+		}
+		if (payload != nullptr) {
+			xor_block(payload, _expr_payload.data() +
+					size_t(_slot[raw]) * _block_size, _block_size);
+		}
+	}
+}
+
+void strsim::rateless_coder::insert_row(const rateless_block * block) {
+	gf2_basis::word_type * row = _basis.row();
+	block->for_each([&] (value_type raw) {
+		add_column(row, nullptr, raw);
+	});
+	_basis.insert();
+}
+
+void strsim::rateless_coder::deactivate(value_type raw) {
+	for (size_type e = _head[raw]; e != NO_EDGE; e = _edge_next[e]) {
+		size_type id = _edge_block[e];
+		if (_active_degree[id] == 0) {
+			continue;
+		}
+		_active_residual[id] ^= raw;
+		if (--_active_degree[id] == 1) {
+			_stack.push_back(id);
+		}
+	}
+}
+
+void strsim::rateless_coder::start_elimination(bool payload) {
+	size_type remaining = 0;
+	_state.resize(_num_blocks);
+	_slot.resize(_num_blocks);
+	for (size_type i = 0; i < _num_blocks; ++i) {
+		_state[i] = _raw_table[i] ? KNOWN : ACTIVE;
+		remaining += !_raw_table[i];
+	}
+	_active_degree.assign(_degree.begin(), _degree.end());
+	_active_residual.assign(_residual.begin(), _residual.end());
+	_stack.clear();
+	_order.clear();
+	_inactive.clear();
+	// peel symbolically, the waiting blocks all have a degree of at
+	// least 2 so start by inactivating raw blocks
+	while (remaining > 0) {
+		while (!_stack.empty()) {
+			size_type id = _stack.back();
+			_stack.pop_back();
+			if (_active_degree[id] != 1) {
+				continue;
 			}
-			if (decoded_block->size() == 1 &&
-					!_raw_table[decoded_block->front()]) {
-				value_type b = decoded_block->front();
-				_raw_queue.push_back(b);
-				_raw_table[b] = true;
-				buffer.push_back(b);
-				decoded_block = _coding_queue.erase(decoded_block);
-				DBG("Block " << b << " recovered");
-			}else{
-				decoded_block++;
+			value_type raw = _active_residual[id];
+			_active_degree[id] = 0;
+			_state[raw] = SOLVED;
+			_slot[raw] = id;
+			_order.push_back(raw);
+			remaining--;
+			deactivate(raw);
+		}
+		if (remaining == 0) {
+			break;
+		}
+		// stuck, inactivate all but one raw block of the shortest block
+		size_type best = NO_EDGE;
+		for (size_type id = 0; id < _active_degree.size(); ++id) {
+			if (_active_degree[id] > 1 && (best == NO_EDGE ||
+					_active_degree[id] < _active_degree[best])) {
+				best = id;
+			}
+		}
+		bool keep = (best != NO_EDGE);
+		for (size_type raw = 0; raw < _num_blocks && best == NO_EDGE; ++raw) {
+			// no block covers what is left, inactivate all of it
+			if (_state[raw] == ACTIVE) {
+				_state[raw] = INACTIVE;
+				_inactive.push_back(raw);
+				remaining--;
+			}
+		}
+		if (best != NO_EDGE) {
+			_pending[best]->for_each([&] (value_type raw) {
+				if (_state[raw] != ACTIVE) {
+					return;
+				}
+				if (keep) {
+					keep = false;
+					return;
+				}
+				_state[raw] = INACTIVE;
+				_inactive.push_back(raw);
+				remaining--;
+				deactivate(raw);
+			});
+		}
+	}
+	// express every solved raw block over the inactive ones, in the
+	// order they were solved so the blocks they depend on come first
+	for (size_type i = 0; i < _inactive.size(); ++i) {
+		_slot[_inactive[i]] = i;
+	}
+	size_t size = payload ? _block_size : 0;
+	_basis.reset(_inactive.size(), size);
+	_used.assign(_degree.size(), false);
+	_expr.assign(_order.size() * _basis.words(), 0);
+	_expr_payload.resize(_order.size() * size);
+	_peeled.resize(_order.size());
+	for (size_type i = 0; i < _order.size(); ++i) {
+		value_type raw = _order[i];
+		size_type id = _slot[raw];
+		uint8_t * constant = nullptr;
+		if (payload) {
+			constant = _expr_payload.data() + i * size;
+			memcpy(constant, work(id), size);
+		}
+		_used[id] = true;
+		_state[raw] = KNOWN; // keep it out of its own expression
+		_pending[id]->for_each([&] (value_type other) {
+			add_column(_expr.data() + size_t(i) * _basis.words(),
+					constant, other);
+		});
+		_state[raw] = SOLVED;
+		_slot[raw] = i;
+		_peeled[i] = id;
+	}
+	// waiting blocks that did not solve anything are equations over
+	// the inactive raw blocks
+	for (size_type id = 0; id < _degree.size(); ++id) {
+		if (_degree[id] == 0 || _used[id]) {
+			continue;
+		}
+		if (!payload) {
+			insert_row(_pending[id]);
+			continue;
+		}
+		gf2_basis::word_type * row = _basis.row();
+		memcpy(_basis.payload(), work(id), size);
+		_pending[id]->for_each([&] (value_type raw) {
+			add_column(row, _basis.payload(), raw);
+		});
+		_basis.insert();
+	}
+	_solved.clear();
+	_eliminating = true;
+}
+
+void strsim::rateless_coder::eliminate(const rateless_block * block) {
+	if (!_inactivation || has_finished()) {
+		return;
+	}
+	if (_eliminating) {
+		// raw blocks peeled since elimination started are known
+		// columns, the new block is one more equation
+		for (value_type raw : _solved) {
+			add_column(_basis.row(), nullptr, raw);
+			_basis.insert();
+		}
+		_solved.clear();
+		if (block != nullptr) {
+			insert_row(block);
+		}
+	}else if (_num_pending >= _num_blocks - _num_recovered) {
+		// peeling stalled with enough equations to solve the rest
+		start_elimination(false);
+	}
+	if (_eliminating && _basis.rank() == _basis.columns()) {
+		// full rank, every missing raw block can be solved
+		if (_block_size > 0) {
+			solve_payload();
+		}
+		for (size_type i = 0; i < _num_blocks; ++i) {
+			if (!_raw_table[i]) {
+				_raw_table[i] = true;
+				_num_recovered++;
 			}
 		}
+		_eliminating = false;
+	}
+}
+
+void strsim::rateless_coder::solve_payload(void) {
+	// the rows seen so far only tracked the rank, build the system
+	// again over what is missing now with the data attached
+	start_elimination(true);
+	std::vector<uint8_t> inactive(_inactive.size() * _block_size);
+	_basis.solve(inactive.data());
+	for (size_type i = 0; i < _inactive.size(); ++i) {
+		memcpy(_data.data() + size_t(_inactive[i]) * _block_size,
+				inactive.data() + size_t(i) * _block_size, _block_size);
+	}
+	// then the peeled ones, each only needs blocks solved before it
+	for (size_type i = 0; i < _order.size(); ++i) {
+		value_type raw = _order[i];
+		uint8_t * out = _data.data() + size_t(raw) * _block_size;
+		memcpy(out, work(_peeled[i]), _block_size);
+		_pending[_peeled[i]]->for_each([&] (value_type other) {
+			if (other != raw && !_raw_table[other]) {
+				xor_block(out, _data.data() + size_t(other) * _block_size,
+						_block_size);
+			}
+		});
 	}
-	return _num_blocks - _raw_queue.size();
 }
 
 void strsim::min_coder::encode(unsigned int inum, unsigned int onum,
-		std::vector<coded_block *> &b) {
+		strsim::block_arena &arena, std::vector<coded_block *> &b) {
 	_num_blocks = _block_left = inum;
+	min_block * blocks = arena.min_blocks(onum);
+	b.clear();
 	for (unsigned int i = 0; i < onum; ++i) {
-		b.push_back(new min_block());
+		b.push_back(&blocks[i]);
 	}
 }
 
@@ -185,3 +605,159 @@ unsigned int strsim::min_coder::decode(coded_block * /* unused */) {
 
 
 
+
+const strsim::coder::size_type strsim::rs_coder::MAX_BLOCKS;
+
+void strsim::rs_coder::encode(unsigned int inum, unsigned int onum,
+		strsim::block_arena &arena, std::vector<coded_block *> &b) {
+	if (onum > MAX_BLOCKS || onum < inum) {
+		throw std::invalid_argument("rs_coder needs inum <= onum <= 256");
+	}
+	if (inum != _num_blocks || onum != _num_coded) {
+		// parity i and raw block j meet at 1 / (x_i + y_j) with
+		// x_i = inum + i and y_j = j, every square part of it is
+		// invertible
+		_num_blocks = inum;
+		_num_coded = onum;
+		_cauchy.resize(size_t(onum - inum) * inum);
+		for (size_type i = 0; i < onum - inum; ++i) {
+			for (size_type j = 0; j < inum; ++j) {
+				_cauchy[size_t(i) * inum + j] = gf_inv((inum + i) ^ j);
+			}
+		}
+	}
+	rs_block * blocks = arena.rs_blocks(onum);
+	if (_block_size > 0) {
+		arena.payload.resize(size_t(onum) * _block_size);
+		_data.resize(size_t(inum) * _block_size);
+	}
+	b.clear();
+	for (unsigned int i = 0; i < onum; ++i) {
+		blocks[i].index = i;
+		blocks[i].payload = (_block_size > 0) ?
+			arena.payload.data() + size_t(i) * _block_size : nullptr;
+		b.push_back(&blocks[i]);
+	}
+	this->restart();
+}
+
+void strsim::rs_coder::encode_payload(const uint8_t * raw,
+		strsim::block_arena &arena) {
+	uint8_t * out = arena.payload.data();
+	memcpy(out, raw, size_t(_num_blocks) * _block_size);
+	for (size_type i = 0; i < _num_coded - _num_blocks; ++i) {
+		uint8_t * parity = out + size_t(_num_blocks + i) * _block_size;
+		memset(parity, 0, _block_size);
+		for (size_type j = 0; j < _num_blocks; ++j) {
+			gf_mul_add(parity, raw + size_t(j) * _block_size,
+					_cauchy[size_t(i) * _num_blocks + j], _block_size);
+		}
+	}
+}
+
+void strsim::rs_coder::receive(size_type row, const uint8_t * source) {
+	if (has_finished() || _have[row]) {
+		return;
+	}
+	_have[row] = true;
+	_rows.push_back(row);
+	_sources.push_back(source);
+	if (has_finished() && _block_size > 0) {
+		solve();
+	}
+}
+
+unsigned int strsim::rs_coder::decode(strsim::coded_block * b) {
+	if (b->type() != this->type()) {
+		DBG("The type of the coded is unknown");
+	}
+	const rs_block * block = static_cast<rs_block*>(b);
+	receive(block->index, block->payload);
+	return _num_blocks - _rows.size();
+}
+
+void strsim::rs_coder::feed(int index) {
+	receive(index, _data.data() + size_t(index) * _block_size);
+}
+
+void strsim::rs_coder::solve(void) {
+	size_type k = _num_blocks;
+	size_t bs = _block_size;
+	std::vector<size_type> missing;
+	std::vector<size_type> parity;
+	for (size_type i = 0; i < _rows.size(); ++i) {
+		if (_rows[i] >= k) {
+			parity.push_back(i);
+		}else if (_sources[i] != _data.data() + _rows[i] * bs) {
+			memcpy(_data.data() + _rows[i] * bs, _sources[i], bs);
+		}
+	}
+	for (size_type j = 0; j < k; ++j) {
+		if (!_have[j]) {
+			missing.push_back(j);
+		}
+	}
+	size_type m = missing.size();
+	if (m == 0) {
+		return;
+	}
+	// take the raw blocks we have out of the parities
+	_rhs.resize(m * bs);
+	_matrix.resize(size_t(m) * m);
+	for (size_type p = 0; p < m; ++p) {
+		size_type row = _rows[parity[p]] - k;
+		const uint8_t * coef = _cauchy.data() + size_t(row) * k;
+		uint8_t * rhs = _rhs.data() + p * bs;
+		memcpy(rhs, _sources[parity[p]], bs);
+		for (size_type j = 0; j < k; ++j) {
+			if (_have[j]) {
+				gf_mul_add(rhs, _data.data() + j * bs, coef[j], bs);
+			}
+		}
+		for (size_type t = 0; t < m; ++t) {
+			_matrix[size_t(p) * m + t] = coef[missing[t]];
+		}
+	}
+	// invert what is left with Gauss-Jordan elimination
+	_inverse.assign(size_t(m) * m, 0);
+	for (size_type i = 0; i < m; ++i) {
+		_inverse[size_t(i) * m + i] = 1;
+	}
+	for (size_type c = 0; c < m; ++c) {
+		size_type pivot = c;
+		while (_matrix[size_t(pivot) * m + c] == 0) {
+			pivot++;
+		}
+		uint8_t * row = _matrix.data() + size_t(c) * m;
+		uint8_t * inv = _inverse.data() + size_t(c) * m;
+		if (pivot != c) {
+			std::swap_ranges(row, row + m, _matrix.data() + size_t(pivot) * m);
+			std::swap_ranges(inv, inv + m, _inverse.data() + size_t(pivot) * m);
+		}
+		uint8_t scale = gf_inv(row[c]);
+		for (size_type t = 0; t < m; ++t) {
+			row[t] = gf_mul(row[t], scale);
+			inv[t] = gf_mul(inv[t], scale);
+		}
+		for (size_type r = 0; r < m; ++r) {
+			uint8_t * other = _matrix.data() + size_t(r) * m;
+			uint8_t * other_inv = _inverse.data() + size_t(r) * m;
+			uint8_t f = other[c];
+			if (r == c || f == 0) {
+				continue;
+			}
+			for (size_type t = 0; t < m; ++t) {
+				other[t] ^= gf_mul(f, row[t]);
+				other_inv[t] ^= gf_mul(f, inv[t]);
+			}
+		}
+	}
+	for (size_type t = 0; t < m; ++t) {
+		uint8_t * out = _data.data() + missing[t] * bs;
+		memset(out, 0, bs);
+		for (size_type p = 0; p < m; ++p) {
+			gf_mul_add(out, _rhs.data() + p * bs,
+					_inverse[size_t(t) * m + p], bs);
+		}
+	}
+}
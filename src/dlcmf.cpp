@@ -11,17 +11,27 @@
  *		- The CMF of arrival time
  *		- The CMF of completion time with caching
  *		- The CMF of completion time without caching
+ *		- The exact CMF of completion time without and with caching,
+ *		from the order statistics of the block latency
+ *		- The exact mean and percentiles of the completion time for
+ *		every multiple of the cache size as cache and as extra blocks
  *
  * */
 
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include "store.h"
+#include "cmf.h"
+#include "kofn.h"
+#include "sketch.h"
 
 #define NUM_TEST 10000
 #define TIME_RANGE 10000
 #define VISUAL_TEST "visual/data/dlcmf"
+#define VISUAL_EXACT "visual/data/dlexact"
 
 int main(int argc, char* argv[]) {
 	
@@ -42,52 +52,86 @@ int main(int argc, char* argv[]) {
 	strsim::gaussian_generator rg(MEAN, STDDEV);
 	//const double RATE = 1 / MEAN;
 	//strsim::exponential_generator rg(RATE);
-	unsigned long * acmf = new unsigned long [TIME_RANGE];
-	unsigned long * cmf = new unsigned long [TIME_RANGE];
-	unsigned long * mcmf = new unsigned long [TIME_RANGE];
+	strsim::cmf acmf(TIME_RANGE);
+	strsim::cmf cmf(TIME_RANGE);
+	strsim::cmf mcmf(TIME_RANGE);
 	std::vector<unsigned int> arrive;
-	
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		acmf[i] = 0;
-		cmf[i] = 0;
-		mcmf[i] = 0;
-	}
 
 	for (unsigned int i = 0; i < NUM_TEST; ++i) {
-		arrive.clear();
-		for (unsigned int j = 0; j < DUP_SIZE; ++j) {
-			unsigned int rta = rg.sample();
-			arrive.push_back(rta);
-			for (unsigned int j = rta; j < TIME_RANGE; ++j) {
-				acmf[j]++;
-			}
+		arrive.resize(DUP_SIZE);
+		rg.sample_batch(arrive.data(), DUP_SIZE);
+		for (unsigned int rta : arrive) {
+			acmf.add(rta);
 		}
 		std::sort(arrive.begin(), arrive.end(),
 				[] (unsigned int f, unsigned int s) -> bool {
 					return (f < s);
 				});
-		for (unsigned long j = arrive[RAW_SIZE-1]; j < TIME_RANGE; ++j) {
-			cmf[j]++;
-		}
-		for (unsigned long j = arrive[RAW_SIZE - CACHE_SIZE - 1];
-				j < TIME_RANGE; ++j) {
-			mcmf[j]++;
-		}
+		cmf.add(arrive[RAW_SIZE-1]);
+		mcmf.add(arrive[RAW_SIZE - CACHE_SIZE - 1]);
 	}
 
+	// the sampled loads against the order statistics of their blocks
+	strsim::kofn_exact exact;
+	exact.add(DUP_SIZE, strsim::cdf_of(rg));
+	const unsigned int CACHED_NEED = RAW_SIZE - CACHE_SIZE;
+	std::cout << "Without cache: exact mean " << exact.mean(RAW_SIZE) <<
+		", p99 " << exact.quantile(RAW_SIZE, 0.99) << std::endl;
+	std::cout << "With cache: exact mean " << exact.mean(CACHED_NEED) <<
+		", p99 " << exact.quantile(CACHED_NEED, 0.99) << std::endl;
+
 	std::ofstream report(VISUAL_TEST);
+	std::vector<unsigned long> arrived = acmf.cumulative();
+	std::vector<unsigned long> complete = cmf.cumulative();
+	std::vector<unsigned long> cached = mcmf.cumulative();
+	double distance = 0, cdistance = 0;
 	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
+		double sampled = double(complete[i]) / double(cmf.total());
+		double csampled = double(cached[i]) / double(mcmf.total());
+		double ecomplete = exact.cdf(RAW_SIZE, i);
+		double ecached = exact.cdf(CACHED_NEED, i);
+		distance = std::max(distance, std::fabs(sampled - ecomplete));
+		cdistance = std::max(cdistance, std::fabs(csampled - ecached));
 		report << i << "," <<
-			double(acmf[i]) / double(acmf[TIME_RANGE-1]) << "," <<
-			double(cmf[i]) / double(cmf[TIME_RANGE-1]) << "," <<
-			double(mcmf[i]) / double(mcmf[TIME_RANGE-1]) << std::endl;
+			double(arrived[i]) / double(arrived[TIME_RANGE-1]) << "," <<
+			double(complete[i]) / double(complete[TIME_RANGE-1]) << "," <<
+			double(cached[i]) / double(cached[TIME_RANGE-1]) << "," <<
+			ecomplete << "," << ecached << std::endl;
 	}
+	std::cout << "Largest gap to the exact CMF: " << distance <<
+		" without cache, " << cdistance << " with cache" << std::endl;
 	
 	report.close();
 
-	delete [] acmf;
-	delete [] cmf;
-	delete [] mcmf;
+	// every multiple of the cache size as cache C and extra blocks K
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+	const unsigned int STEP = (CACHE_SIZE > 0) ? CACHE_SIZE : RAW_SIZE;
+	std::ofstream grid(VISUAL_EXACT);
+	grid << "C,K,avg_latency," <<
+		strsim::quantile_sketch::percentile_header() << std::endl;
+	const double percentiles[] = {strsim::quantile_sketch::P50,
+		strsim::quantile_sketch::P90, strsim::quantile_sketch::P99,
+		strsim::quantile_sketch::P999, strsim::quantile_sketch::P9999};
+	unsigned int cells = 0;
+	for (unsigned int extra = 0; RAW_SIZE + extra <= DUP_SIZE;
+			extra += STEP) {
+		exact.clear();
+		exact.add(RAW_SIZE + extra, strsim::cdf_of(rg));
+		for (unsigned int c = 0; c < RAW_SIZE; c += STEP) {
+			grid << c << "," << extra << "," << exact.mean(RAW_SIZE - c);
+			for (double q : percentiles) {
+				grid << "," << exact.quantile(RAW_SIZE - c, q);
+			}
+			grid << std::endl;
+			cells++;
+		}
+	}
+	grid.close();
+	std::cout << "Exact grid of " << cells << " settings in " <<
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count() <<
+		" ms" << std::endl;
 
 }
 
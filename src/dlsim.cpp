@@ -7,19 +7,24 @@
  * 	- dup_factor (step of increament
  * 	- max_dupfactor (the highest amount of duplication
  * 	- cache_factor
+ * Every trial draws the arrivals of the highest duplication once, lower
+ * duplication factors use a prefix of the same blocks.
  * Output:
  *  - The CMF of arrival time
  *  - The CMF of completion time with different dup factors with caching
  *  - The CMF of completion time with different dup facotrs without caching
+ *  - The average, tail and p50 to p99.99 latency with and without caching
  * */
 
 #include <iostream>
-#include <list>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include "code.h"
 #include "store.h"
+#include "cmf.h"
+#include "sketch.h"
+#include "kofn.h"
 
 #define SHAPE 3
 #define RATE 2.0
@@ -32,21 +37,35 @@
 #define VISUAL_DLCMF "visual/data/dlcmf"
 #define VISUAL_DLTL "visual/data/dltl"
 
-struct loadrecord {
-	unsigned long restore [TIME_RANGE];
-	unsigned long complete [TIME_RANGE];
-	std::vector<time_t> latency;
-	loadrecord() {
-		for (int i = 0; i < TIME_RANGE; ++i) {
-			restore[i] = complete[i] = 0;
-		}
+/* Keep the cap earliest arrivals seen so far in a max-heap */
+static void keep_earliest(std::vector<time_t> &heap, unsigned int cap,
+		time_t atime) {
+	if (heap.size() < cap) {
+		heap.push_back(atime);
+		std::push_heap(heap.begin(), heap.end());
+	} else if (cap > 0 && atime < heap.front()) {
+		std::pop_heap(heap.begin(), heap.end());
+		heap.back() = atime;
+		std::push_heap(heap.begin(), heap.end());
 	}
+}
+
+/* time bins of the records, STRSIM_TIME_AXIS overrides the default of
+ * one bin per time unit up to TIME_RANGE */
+const strsim::time_axis& report_axis(void) {
+	static const strsim::time_axis axis =
+		strsim::time_axis::from_env(TIME_RANGE);
+	return axis;
+}
+
+struct loadrecord {
+	strsim::cmf32 restore;
+	strsim::cmf32 complete;
+	strsim::quantile_sketch latency;
+	loadrecord() : restore(report_axis()),
+		complete(report_axis()) {}
 	time_t avg_latency() {
-		time_t sumlt = 0;
-		for (time_t lt : latency) {
-			sumlt += lt;
-		}
-		return sumlt / latency.size();
+		return latency.sum() / latency.count();
 	}
 };
 
@@ -63,101 +82,86 @@ int main(int argc, char ** argv) {
 	
 	const unsigned int CACHED_SIZE = RAW_SIZE * CACHE_FACTOR;
 	const unsigned int MAXDUP = RAW_SIZE * MAX_DUPFACTOR;
-	unsigned int num_blocks = RAW_SIZE;
-	unsigned long * arrival = new unsigned long [TIME_RANGE];
+	strsim::cmf arrival(report_axis());
 	
-	strsim::min_coder coder;
 	//strsim::erlang_generator eg(SHAPE, RATE, DELAY);
 	strsim::gaussian_generator gg(4.0, 0.2);
+	strsim::kofn_trial kofn;
 
-	std::list<loadrecord> data;
-	std::list<loadrecord> cdata;
+	std::vector<unsigned int> sizes;
+	for (unsigned int num_blocks = RAW_SIZE; num_blocks <= MAXDUP;
+			num_blocks += (unsigned int)(RAW_SIZE * DUP_FACTOR)) {
+		sizes.push_back(num_blocks);
+	}
+	std::vector<loadrecord> data(sizes.size());
+	std::vector<loadrecord> cdata(sizes.size());
 
-	while (num_blocks <= MAXDUP) {
-		loadrecord trail;
-		loadrecord ctrail;
-		std::cout << "Load data with extra " <<
-			double(num_blocks - RAW_SIZE) / RAW_SIZE * 100 <<
-			"%" << std::endl;
-		for (unsigned int i = 0; i < NUM_TEST; ++i) {
-			std::vector<strsim::coded_block *> blocks;
-			coder.encode(RAW_SIZE, num_blocks, blocks);
-			for (auto block : blocks) {
-				//block->arrieve_time = eg.sample();
-				block->arrieve_time = gg.sample();
-				if (block->arrieve_time >= TIME_RANGE) {
-					continue;
-				}
-				for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-					arrival[j]++;
-				}
+	// with min_coder the data is back at the k-th arrival, or the
+	// (k - C)-th one with caching. Growing the prefix of blocks one
+	// duplication step at a time, the earliest k and k - C arrivals
+	// so far are kept in max-heaps whose tops are the completion times.
+	unsigned int need = (RAW_SIZE > CACHED_SIZE) ?
+		RAW_SIZE - CACHED_SIZE : 1;
+	std::vector<time_t> first;
+	std::vector<time_t> cfirst;
+	std::cout << "Load data with " << sizes.size() <<
+		" duplication factors" << std::endl;
+	for (unsigned int i = 0; i < NUM_TEST && !sizes.empty(); ++i) {
+		kofn.clear();
+		//kofn.sample(sizes.back(), eg);
+		kofn.sample(sizes.back(), gg);
+		const std::vector<time_t> &times = kofn.times();
+		first.clear();
+		cfirst.clear();
+		unsigned int num_blocks = 0;
+		for (unsigned int j = 0; j < sizes.size(); ++j) {
+			for (; num_blocks < sizes[j]; ++num_blocks) {
+				arrival.add(times[num_blocks]);
+				keep_earliest(first, RAW_SIZE, times[num_blocks]);
+				keep_earliest(cfirst, need, times[num_blocks]);
 			}
-			std::sort(blocks.begin(), blocks.end(),
-				[] (strsim::coded_block* f,
-						strsim::coded_block *s) -> bool {
-					return (f->arrieve_time < s->arrieve_time);
-			});
-			coder.restart();
-			unsigned int lastleft = RAW_SIZE;
-			bool wait = true;
-			for (auto block : blocks) {
-				unsigned int bleft = coder.decode(block);
-				time_t atime = block->arrieve_time;
-				delete block;
-				if (bleft < lastleft) {
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.restore[j] += lastleft - bleft;
-						ctrail.restore[j] += lastleft - bleft;
-					}
-					lastleft = bleft;
-				}
-				if (bleft <= CACHED_SIZE && wait) {
-					ctrail.latency.push_back(atime);
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						ctrail.complete[j]++;
-					}
-					wait = false;
-				}
-				if (coder.has_finished()) {
-					trail.latency.push_back(atime);
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.complete[j]++;
-					}
-					break;
-				}
+			for (time_t atime : first) {
+				data[j].restore.add(atime);
+				cdata[j].restore.add(atime);
+			}
+			if (cfirst.size() == need) {
+				cdata[j].latency.add(cfirst.front());
+				cdata[j].complete.add(cfirst.front());
+			}
+			if (first.size() == RAW_SIZE) {
+				data[j].latency.add(first.front());
+				data[j].complete.add(first.front());
 			}
 		}
-		data.push_back(trail);
-		cdata.push_back(ctrail);
-		num_blocks += (unsigned int)(RAW_SIZE * DUP_FACTOR);
 	}
 
 	std::ofstream report_cmf(VISUAL_DLCMF);
 	report_cmf << "Time,Arrival,";
 	unsigned int factor = 0;
-	for (auto& record : data) {
+	for (unsigned int i = 0; i < data.size(); ++i) {
 		report_cmf << "mn-" << factor << ",";
-		std::sort(record.latency.begin(), record.latency.end());
 		factor += RAW_SIZE * DUP_FACTOR;
 	}
 	factor = 0;
-	for (auto& record : cdata) {
+	for (unsigned int i = 0; i < cdata.size(); ++i) {
 		report_cmf << "cachemn-" << factor << ",";
-		std::sort(record.latency.begin(), record.latency.end());
 		factor += RAW_SIZE * DUP_FACTOR;
 	}
 	report_cmf << std::endl;
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[i]) /
-			double(arrival[TIME_RANGE-1]) << ",";
-		for (auto& record : data) {
-			report_cmf << double(record.complete[i]) /
-				double(record.complete[TIME_RANGE-1]) << ",";
-		}
-		for (auto& record : cdata) {
-			report_cmf << double(record.complete[i]) /
-				double(record.complete[TIME_RANGE-1]) << ",";
+	std::vector<double> arrived = arrival.distribution();
+	std::vector<std::vector<double> > completed;
+	for (auto& record : data) {
+		completed.push_back(record.complete.distribution());
+	}
+	for (auto& record : cdata) {
+		completed.push_back(record.complete.distribution());
+	}
+	const strsim::time_axis &axis = report_axis();
+	for (unsigned int b = 0; b < axis.bins(); ++b) {
+		report_cmf << double(axis.last(b)) / 1000 << "," <<
+			arrived[b] << ",";
+		for (auto& complete : completed) {
+			report_cmf << complete[b] << ",";
 		}
 		report_cmf << std::endl;
 	}
@@ -165,16 +169,21 @@ int main(int argc, char ** argv) {
 	std::ofstream report_dl(VISUAL_DLTL);
 	auto ltdata = data.begin();
 	auto ltcdata = cdata.begin();
-	unsigned tid = NUM_TEST / 100 * 99;
 	report_dl << "extra," <<
 		"avg_latency,cache_avg_latency," << 
-		"tail_latency,cache_tail_latency" << std::endl;
+		"tail_latency,cache_tail_latency," <<
+		strsim::quantile_sketch::percentile_header() << "," <<
+		strsim::quantile_sketch::percentile_header("cache_") << std::endl;
 	for (unsigned int i = 0; i < MAXDUP - RAW_SIZE;
 			i += RAW_SIZE*DUP_FACTOR) {
 		report_dl << i << "," <<
 			ltdata->avg_latency() << "," << ltcdata->avg_latency() << "," <<
-			ltdata->latency[tid] << "," <<
-			ltcdata->latency[tid] << std::endl;
+			ltdata->latency.quantile(strsim::quantile_sketch::P99) << "," <<
+			ltcdata->latency.quantile(strsim::quantile_sketch::P99) << ",";
+		ltdata->latency.write_percentiles(report_dl);
+		report_dl << ",";
+		ltcdata->latency.write_percentiles(report_dl);
+		report_dl << std::endl;
 		ltdata++;
 		ltcdata++;
 	}
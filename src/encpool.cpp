@@ -0,0 +1,157 @@
+#include "encpool.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char MAGIC[8] = {'S', 'T', 'R', 'S', 'E', 'N', 'C', '\0'};
+
+const uint32_t strsim::encoding_pool::VERSION;
+
+// streams of the encodings, apart from those of the trials of a run
+// with the same seed
+static const uint64_t POOL_STREAM = uint64_t(1) << 62;
+
+/* bytes of a pool file with the parameters of a header */
+static size_t file_size(const strsim::encoding_pool::header &h) {
+	size_t size = sizeof(h) + (size_t(h.count) + 1) * sizeof(uint64_t) +
+		size_t(h.count) * (h.onum + 1) * sizeof(uint32_t);
+	return size + h.edges * ((h.inum > 0x10000) ? 4 : 2);
+}
+
+bool strsim::encoding_pool::open(const std::string &path, size_type inum,
+		size_type onum, const std::string &degree, uint64_t seed) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	void * map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(header)) {
+		map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	const header * h = static_cast<const header *>(map);
+	if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+			h->version != VERSION || h->inum != inum || h->onum != onum ||
+			h->seed != seed || h->count == 0 ||
+			strncmp(h->degree, degree.c_str(), sizeof(h->degree)) != 0 ||
+			file_size(*h) != size_t(st.st_size)) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	_map = map;
+	_length = st.st_size;
+	_header = h;
+	_start = reinterpret_cast<const uint64_t *>(h + 1);
+	_offset = reinterpret_cast<const uint32_t *>(_start + h->count + 1);
+	_edge = _offset + size_t(h->count) * (h->onum + 1);
+	return true;
+}
+
+bool strsim::encoding_pool::build(const std::string &path,
+		const coder_factory &make, size_type inum, size_type onum,
+		size_type count, uint64_t seed, task_pool &pool) {
+	close();
+	// a worker whose tasks are all stolen never makes a coder, so the
+	// degree distribution comes from a coder of its own
+	rateless_coder * probe = make();
+	std::string degree = probe->degree();
+	delete probe;
+	std::vector<rateless_coder *> coders(pool.workers(), nullptr);
+	std::vector<block_arena> arenas(pool.workers());
+	std::vector<std::vector<coded_block *> > blocks(pool.workers());
+	// offsets and edges of every encoding until they are written
+	std::vector<std::vector<uint32_t> > offsets(count);
+	std::vector<std::vector<uint32_t> > edges(count);
+	pool.run(count, [&] (size_type id, unsigned int w) {
+		if (coders[w] == nullptr) {
+			coders[w] = make();
+		}
+		coders[w]->seed(seed, POOL_STREAM | id);
+		coders[w]->encode(inum, onum, arenas[w], blocks[w]);
+		const rateless_encoding &encoding = arenas[w].encoding;
+		offsets[id].assign(1, 0);
+		edges[id].clear();
+		for (size_type i = 0; i < encoding.size(); ++i) {
+			encoding.for_each(i, [&] (value_type raw) {
+				edges[id].push_back(raw);
+			});
+			offsets[id].push_back(edges[id].size());
+		}
+	});
+	header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.inum = inum;
+	h.onum = onum;
+	h.count = count;
+	h.seed = seed;
+	strncpy(h.degree, degree.c_str(), sizeof(h.degree) - 1);
+	std::vector<uint64_t> start(1, 0);
+	for (size_type e = 0; e < count; ++e) {
+		start.push_back(start.back() + edges[e].size());
+	}
+	h.edges = start.back();
+	for (auto coder : coders) {
+		delete coder;
+	}
+	// write next to the file and rename, so that a run never maps a
+	// pool another run is still writing
+	std::ostringstream tmp;
+	tmp << path << "." << getpid();
+	std::ofstream out(tmp.str(), std::ios::binary);
+	out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+	out.write(reinterpret_cast<const char *>(start.data()),
+		start.size() * sizeof(uint64_t));
+	for (size_type e = 0; e < count; ++e) {
+		out.write(reinterpret_cast<const char *>(offsets[e].data()),
+			offsets[e].size() * sizeof(uint32_t));
+	}
+	for (size_type e = 0; e < count; ++e) {
+		if (inum > 0x10000) {
+			out.write(reinterpret_cast<const char *>(edges[e].data()),
+				edges[e].size() * sizeof(uint32_t));
+			continue;
+		}
+		std::vector<uint16_t> narrow(edges[e].begin(), edges[e].end());
+		out.write(reinterpret_cast<const char *>(narrow.data()),
+			narrow.size() * sizeof(uint16_t));
+	}
+	out.close();
+	if (!out || std::rename(tmp.str().c_str(), path.c_str()) != 0) {
+		std::remove(tmp.str().c_str());
+		return false;
+	}
+	return open(path, inum, onum, degree, seed);
+}
+
+void strsim::encoding_pool::close(void) {
+	if (_map != nullptr) {
+		munmap(_map, _length);
+	}
+	_map = nullptr;
+	_length = 0;
+	_header = nullptr;
+	_start = nullptr;
+	_offset = nullptr;
+	_edge = nullptr;
+}
+
+std::string strsim::encoding_pool::file_name(const std::string &dir,
+		size_type inum, size_type onum, const std::string &degree,
+		uint64_t seed) {
+	std::ostringstream name;
+	name << dir << "/" << degree << "-" << inum << "-" << onum << "-" <<
+		std::hex << seed << ".enc";
+	return name.str();
+}
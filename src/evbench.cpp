@@ -0,0 +1,160 @@
+/*
+ * Measure the cost of the bounded-window trials of lbwsim on the event
+ * engine against the std::priority_queue loop it replaced
+ * Input:
+ * 	- raw_size
+ * 	- dup_factor
+ * 	- load_factor
+ * Output:
+ *  - Nanoseconds per arrival of each loop, on the same blocks and
+ *  latencies, and the average time the data is back as a check that
+ *  both simulate the same trials
+ *
+ * */
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include "code.h"
+#include "store.h"
+#include "event.h"
+
+#define NUM_TEST 10000
+
+typedef std::chrono::steady_clock bench_clock;
+
+double seconds(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+struct blockcomp {
+	bool operator() (const strsim::coded_block *a,
+			const strsim::coded_block *b) const {
+		return a->arrieve_time > b->arrieve_time;
+	}
+};
+
+/* Trial on a priority queue of blocks: every arrival is decoded and
+ * sends the next request until the data is back. Returns the time it is
+ * back and adds the arrivals to events. */
+time_t queue_trial(strsim::min_coder &coder, strsim::gaussian_generator &gg,
+		std::vector<strsim::coded_block *> &blocks, unsigned int num_load,
+		unsigned long &events) {
+	std::priority_queue<strsim::coded_block*,
+		std::vector<strsim::coded_block*>, blockcomp> block_queue;
+	unsigned int cid = 0;
+	for (; cid < num_load && cid < blocks.size(); ++cid) {
+		blocks[cid]->arrieve_time = gg.sample();
+		block_queue.push(blocks[cid]);
+	}
+	while (!block_queue.empty()) {
+		strsim::coded_block * block = block_queue.top();
+		block_queue.pop();
+		events++;
+		time_t atime = block->arrieve_time;
+		if (coder.decode(block) == 0) {
+			return atime;
+		}
+		if (cid < blocks.size()) {
+			blocks[cid]->arrieve_time = atime + gg.sample();
+			block_queue.push(blocks[cid]);
+			cid++;
+		}
+	}
+	return 0;
+}
+
+/* The same trial as handler of the event engine */
+struct engine_trial : strsim::event_handler {
+	strsim::event_engine &engine;
+	strsim::min_coder &coder;
+	strsim::gaussian_generator &gg;
+	std::vector<strsim::coded_block *> &blocks;
+	unsigned int issued;
+	unsigned long events;
+	time_t done;
+
+	engine_trial(strsim::event_engine &engine, strsim::min_coder &coder,
+			strsim::gaussian_generator &gg,
+			std::vector<strsim::coded_block *> &blocks) :
+		engine(engine), coder(coder), gg(gg), blocks(blocks), issued(0),
+		events(0), done(0) {}
+
+	void issue(const event &e) {
+		blocks[e.id]->arrieve_time = e.time + gg.sample();
+		engine.schedule(blocks[e.id]->arrieve_time,
+			strsim::event_engine::ARRIVE, e.id);
+	}
+
+	void arrive(const event &e) {
+		events++;
+		if (coder.decode(blocks[e.id]) == 0) {
+			done = e.time;
+			engine.stop();
+		} else if (issued < blocks.size()) {
+			engine.dispatch(*this, strsim::event_engine::ISSUE, issued++);
+		}
+	}
+
+	time_t run(unsigned int num_load) {
+		engine.reset();
+		done = 0;
+		for (issued = 0; issued < num_load && issued < blocks.size();
+				++issued) {
+			engine.schedule(0, strsim::event_engine::ISSUE, issued);
+		}
+		engine.run(*this);
+		return done;
+	}
+};
+
+int main(int argc, char ** argv) {
+	if (argc != 4) {
+		std::cerr << "Usage: evbench [raw_size] [dup_factor] [load_factor]"
+			<< std::endl;
+		return 1;
+	}
+	const unsigned int RAW_SIZE = std::stoi(argv[1]);
+	const double DUP_FACTOR = std::stod(argv[2]);
+	const double LOAD_FACTOR = std::stod(argv[3]);
+	unsigned int num_blocks = RAW_SIZE * DUP_FACTOR;
+	unsigned int num_load = RAW_SIZE * LOAD_FACTOR;
+
+	strsim::min_coder coder;
+	strsim::gaussian_generator gg(3.0, 2.0);
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block *> blocks;
+	strsim::event_engine engine;
+	engine_trial trial(engine, coder, gg, blocks);
+
+	// both loops draw the latencies of a trial from the same stream
+	const uint64_t key = strsim::global_seed();
+	double queue_time = 0;
+	double engine_time = 0;
+	unsigned long queue_events = 0;
+	double queue_done = 0;
+	double engine_done = 0;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		coder.encode(RAW_SIZE, num_blocks, arena, blocks);
+
+		coder.restart();
+		gg.seed(key, i);
+		bench_clock::time_point start = bench_clock::now();
+		queue_done += queue_trial(coder, gg, blocks, num_load,
+			queue_events);
+		queue_time += seconds(start);
+
+		coder.restart();
+		gg.seed(key, i);
+		start = bench_clock::now();
+		engine_done += trial.run(num_load);
+		engine_time += seconds(start);
+	}
+
+	std::cout << "loop,ns_per_arrival,avg_done" << std::endl;
+	std::cout << "priority_queue," << queue_time * 1e9 / queue_events <<
+		"," << queue_done / NUM_TEST << std::endl;
+	std::cout << "event_engine," << engine_time * 1e9 / trial.events <<
+		"," << engine_done / NUM_TEST << std::endl;
+}
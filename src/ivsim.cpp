@@ -0,0 +1,127 @@
+/*
+ * Simulate the gain of inactivation decoding over plain peeling
+ * for LT codes
+ * Input:
+ * 	- raw_size
+ * 	- dup_factor
+ * Output:
+ *  - The average and tail number of blocks needed with and without
+ *  inactivation decoding
+ *  - The average and tail latency with and without inactivation
+ *  decoding
+ *  - The p50, p90, p99, p99.9 and p99.99 latency of both decoders
+ *
+ * */
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "code.h"
+#include "store.h"
+#include "sketch.h"
+
+#define MU 4
+#define SIGMA 1
+
+#define ROBUST_C 0.03
+#define ROBUST_DELTA 0.5
+
+#define NUM_TEST 10000
+
+#define VISUAL_IVTL "visual/data/ivtl"
+
+struct loadrecord {
+	strsim::quantile_sketch blocks;
+	strsim::quantile_sketch latency;
+	double avg_blocks() {
+		return double(blocks.sum()) / blocks.count();
+	}
+	time_t avg_latency() {
+		return latency.sum() / latency.count();
+	}
+};
+
+/* Decode blocks in arrival order, return the number of blocks used */
+unsigned int load(strsim::rateless_coder &coder,
+		std::vector<strsim::coded_block *> &blocks, loadrecord &trail) {
+	coder.restart();
+	unsigned int used = 0;
+	for (auto block : blocks) {
+		used++;
+		coder.decode(block);
+		if (coder.has_finished()) {
+			trail.blocks.add(used);
+			trail.latency.add(block->arrieve_time);
+			break;
+		}
+	}
+	return used;
+}
+
+int main(int argc, char ** argv) {
+	if (argc != 3) {
+		std::cerr << "Usage: ivsim [raw_size] [dup_factor]" << std::endl;
+		return 1;
+	}
+	const unsigned int RAW_SIZE = std::stoi(argv[1]);
+	const double DUP_FACTOR = std::stod(argv[2]);
+	const unsigned int CODED_SIZE = RAW_SIZE * DUP_FACTOR;
+
+	strsim::luby_coder coder(ROBUST_C, ROBUST_DELTA);
+	strsim::gaussian_generator gg(MU, SIGMA);
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block *> blocks;
+	std::vector<strsim::rnd_generator::value_type> draw;
+
+	loadrecord peel;
+	loadrecord inact;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		if ((i+1) % (NUM_TEST / 10) == 0) {
+			std::cout << "Processed " <<
+				(i+1) / (NUM_TEST / 100) << "%" << std::endl;
+		}
+		coder.inactivation(false);
+		coder.encode(RAW_SIZE, CODED_SIZE, arena, blocks);
+		strsim::sample_arrivals(gg, blocks.data(), blocks.size(), draw);
+		std::sort(blocks.begin(), blocks.end(),
+			[] (strsim::coded_block* f,
+					strsim::coded_block *s) -> bool {
+				return (f->arrieve_time < s->arrieve_time);
+		});
+		// same arrival order for both decoders
+		load(coder, blocks, peel);
+		coder.inactivation(true);
+		load(coder, blocks, inact);
+	}
+
+	const double TAIL = strsim::quantile_sketch::P99;
+	std::cout << "avg blocks peeling = " << peel.avg_blocks() << std::endl;
+	std::cout << "avg blocks inactivation = " <<
+		inact.avg_blocks() << std::endl;
+	std::cout << "Reduction avg blocks = " <<
+		(peel.avg_blocks() - inact.avg_blocks()) / peel.avg_blocks() <<
+		std::endl;
+	std::cout << "99-th blocks peeling = " << peel.blocks.quantile(TAIL) << std::endl;
+	std::cout << "99-th blocks inactivation = " <<
+		inact.blocks.quantile(TAIL) << std::endl;
+	std::cout << "99-th latency peeling = " << peel.latency.quantile(TAIL) << std::endl;
+	std::cout << "99-th latency inactivation = " <<
+		inact.latency.quantile(TAIL) << std::endl;
+
+	std::ofstream report_iv(VISUAL_IVTL);
+	report_iv << "decoder,avg_blocks,tail_blocks," <<
+		"avg_latency,tail_latency," <<
+		strsim::quantile_sketch::percentile_header() << std::endl;
+	report_iv << "peeling," << peel.avg_blocks() << "," <<
+		peel.blocks.quantile(TAIL) << "," << peel.avg_latency() << "," <<
+		peel.latency.quantile(TAIL) << ",";
+	peel.latency.write_percentiles(report_iv);
+	report_iv << std::endl;
+	report_iv << "inactivation," << inact.avg_blocks() << "," <<
+		inact.blocks.quantile(TAIL) << "," << inact.avg_latency() << "," <<
+		inact.latency.quantile(TAIL) << ",";
+	inact.latency.write_percentiles(report_iv);
+	report_iv << std::endl;
+	report_iv.close();
+}
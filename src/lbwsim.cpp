@@ -6,21 +6,24 @@
  * 	- dup_factod
  * 	- cache_factor (step of increment)
  * 	- max_cachefactor
+ * Every trial is evaluated for all cache sizes at once.
  * Output:
  *  - The CMF of arrival time
  *  - The CMF of completion time with different amount of caching
  *  - The average and tail latency with diffrent amount of caching
+ *  - The p50, p90, p99, p99.9 and p99.99 latency of each setting
  *
  * */
 
 #include <iostream>
-#include <list>
 #include <vector>
-#include <queue>
 #include <fstream>
 #include <algorithm>
 #include "code.h"
 #include "store.h"
+#include "cmf.h"
+#include "sketch.h"
+#include "event.h"
 
 #define SHAPE 3
 #define RATE 2.0
@@ -33,28 +36,82 @@
 #define VISUAL_DLCMF "visual/data/lbwcmf"
 #define VISUAL_DLTL "visual/data/lbwtl"
 
-class blockcomp {
-public:
-	bool operator()(strsim::coded_block * f, strsim::coded_block * s) {
-		return f->arrieve_time > s->arrieve_time;
+/* time bins of the records, STRSIM_TIME_AXIS overrides the default of
+ * one bin per time unit up to TIME_RANGE */
+const strsim::time_axis& report_axis(void) {
+	static const strsim::time_axis axis =
+		strsim::time_axis::from_env(TIME_RANGE);
+	return axis;
+}
+
+struct loadrecord {
+	strsim::cmf32 restore;
+	strsim::cmf32 complete;
+	strsim::quantile_sketch latency;
+	loadrecord() : restore(report_axis()),
+		complete(report_axis()) {}
+	time_t avg_latency() {
+		return latency.sum() / latency.count();
 	}
 };
 
-struct loadrecord {
-	unsigned long restore [TIME_RANGE];
-	unsigned long complete [TIME_RANGE];
-	std::vector<time_t> latency;
-	loadrecord() {
-		for (int i = 0; i < TIME_RANGE; ++i) {
-			restore[i] = complete[i] = 0;
+/* Handler of the events of a trial. Restored blocks go to the largest
+ * cache size still waiting and are summed up after the trials. */
+struct trial : strsim::event_handler {
+	strsim::event_engine &engine;
+	strsim::min_coder &coder;
+	strsim::gaussian_generator &gg;
+	std::vector<strsim::coded_block *> &blocks;
+	// the first time at most C raw blocks are missing only decreases
+	// with C, so one decode trace serves every cache size
+	const std::vector<unsigned int> &caches;
+	std::vector<loadrecord> &data;
+	unsigned int issued;
+	unsigned int lastleft;
+	// cache sizes finish from the largest down, those from open on are
+	// done
+	unsigned int open;
+
+	trial(strsim::event_engine &engine, strsim::min_coder &coder,
+			strsim::gaussian_generator &gg,
+			std::vector<strsim::coded_block *> &blocks,
+			const std::vector<unsigned int> &caches,
+			std::vector<loadrecord> &data) : engine(engine),
+		coder(coder), gg(gg), blocks(blocks), caches(caches), data(data),
+		issued(0), lastleft(0), open(0) {}
+
+	void issue(const event &e) {
+		blocks[e.id]->arrieve_time = e.time + gg.sample();
+		engine.schedule(blocks[e.id]->arrieve_time,
+			strsim::event_engine::ARRIVE, e.id);
+	}
+
+	void arrive(const event &e) {
+		unsigned int bleft = coder.decode(blocks[e.id]);
+		if (bleft < lastleft) {
+			engine.dispatch(*this, strsim::event_engine::PROGRESS, e.id,
+				bleft);
+		}
+		if (!engine.stopped() && issued < blocks.size()) {
+			engine.dispatch(*this, strsim::event_engine::ISSUE, issued++);
 		}
 	}
-	time_t avg_latency() {
-		time_t sumlt = 0;
-		for (time_t lt : latency) {
-			sumlt += lt;
+
+	void progress(const event &e) {
+		unsigned int bleft = e.value;
+		if (bleft >= lastleft) {
+			return;
+		}
+		data[open - 1].restore.add(e.time, lastleft - bleft);
+		lastleft = bleft;
+		while (open > 0 && bleft <= caches[open - 1]) {
+			data[open - 1].latency.add(e.time);
+			data[open - 1].complete.add(e.time);
+			open--;
+		}
+		if (open == 0) {
+			engine.stop();
 		}
-		return sumlt / latency.size();
 	}
 };
 
@@ -71,96 +128,83 @@ int main(int argc, char ** argv) {
 	const double LOAD_FACTOR = std::stod(argv[5]);
 	
 	const unsigned int MAXCACHE = RAW_SIZE * MAX_CACHEFACTOR;
-	unsigned int cached_size = 0;
 	unsigned int num_blocks = RAW_SIZE * DUP_FACTOR;
 	unsigned int num_load = RAW_SIZE * LOAD_FACTOR;
-	unsigned long * arrival = new unsigned long [TIME_RANGE];
+	strsim::cmf arrival(report_axis());
 	
 	strsim::min_coder coder;
 	//strsim::erlang_generator eg(SHAPE, RATE, DELAY);
 	strsim::gaussian_generator gg(3.0, 2.0);
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block *> blocks;
+
+	std::vector<unsigned int> caches;
+	for (unsigned int cached_size = 0; cached_size <= MAXCACHE;
+			cached_size += (unsigned int)(RAW_SIZE * CACHE_FACTOR)) {
+		caches.push_back(cached_size);
+	}
+	std::vector<loadrecord> data(caches.size());
+
+	// a trial keeps num_load requests outstanding: every arrival is
+	// decoded and, unless the data is back, sends the next request
+	strsim::event_engine engine;
+	trial t(engine, coder, gg, blocks, caches, data);
 
-	std::list<loadrecord> data;
-
-	while (cached_size <= MAXCACHE) {
-		loadrecord trail;
-		std::cout << "Load data with cache size " <<
-			cached_size << std::endl;
-		for (unsigned int i = 0; i < NUM_TEST; ++i) {
-			std::vector<strsim::coded_block *> blocks;
-			std::priority_queue<strsim::coded_block*,
-				std::vector<strsim::coded_block*>, blockcomp> block_queue;
-			coder.encode(RAW_SIZE, num_blocks, blocks);
-			for (unsigned int i = 0; i < num_load; ++i) {
-				blocks[i]->arrieve_time = gg.sample();
-				block_queue.push(blocks[i]);
-			}
-			coder.restart();
-			unsigned int lastleft = RAW_SIZE;
-			unsigned int cid = num_load;
-			while (cid < blocks.size()) {
-				strsim::coded_block * block = block_queue.top();
-				unsigned int bleft = coder.decode(block);
-				time_t atime = block->arrieve_time;
-				//delete block;
-				if (bleft < lastleft) {
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.restore[j] += lastleft - bleft;
-					}
-					lastleft = bleft;
-				}
-				if (bleft <= cached_size) {
-					trail.latency.push_back(atime);
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.complete[j]++;
-					}
-					break;
-				}
-				block_queue.pop();
-				blocks[cid]->arrieve_time = atime + gg.sample();
-				block_queue.push(blocks[cid]);
-				cid++;
-			}
-			for (unsigned int j = 0; j < cid; ++j) {
-				for (time_t k = blocks[j]->arrieve_time;
-						k < TIME_RANGE; ++k) {
-					arrival[k]++;
-				}
-			}
+	std::cout << "Load data with " << caches.size() << " cache sizes" <<
+		std::endl;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		coder.encode(RAW_SIZE, num_blocks, arena, blocks);
+		coder.restart();
+		engine.reset();
+		t.lastleft = RAW_SIZE;
+		t.open = caches.size();
+		for (t.issued = 0; t.issued < num_load &&
+				t.issued < blocks.size(); ++t.issued) {
+			engine.schedule(0, strsim::event_engine::ISSUE, t.issued);
 		}
-		data.push_back(trail);
-		cached_size += (unsigned int)(RAW_SIZE * CACHE_FACTOR);
+		engine.run(t);
+		for (unsigned int j = 0; j < t.issued; ++j) {
+			arrival.add(blocks[j]->arrieve_time);
+		}
+	}
+	for (unsigned int j = caches.size() - 1; j-- > 0;) {
+		data[j].restore += data[j + 1].restore;
 	}
 
 	std::ofstream report_cmf(VISUAL_DLCMF);
 	report_cmf << "Time,Arrival,";
 	unsigned int factor = 0;
-	for (auto& record : data) {
+	for (unsigned int i = 0; i < data.size(); ++i) {
 		report_cmf << factor << ",";
-		std::sort(record.latency.begin(), record.latency.end());
 		factor += RAW_SIZE * CACHE_FACTOR;
 	}
 	report_cmf << std::endl;
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[i]) /
-			double(arrival[TIME_RANGE-1]) << ",";
-		for (auto& record : data) {
-			report_cmf << double(record.complete[i]) /
-				double(record.complete[TIME_RANGE-1]) << ",";
+	std::vector<double> arrived = arrival.distribution();
+	std::vector<std::vector<double> > completed;
+	for (auto& record : data) {
+		completed.push_back(record.complete.distribution());
+	}
+	const strsim::time_axis &axis = report_axis();
+	for (unsigned int b = 0; b < axis.bins(); ++b) {
+		report_cmf << double(axis.last(b)) / 1000 << "," <<
+			arrived[b] << ",";
+		for (auto& complete : completed) {
+			report_cmf << complete[b] << ",";
 		}
 		report_cmf << std::endl;
 	}
 	
 	std::ofstream report_dl(VISUAL_DLTL);
 	auto ltdata = data.begin();
-	unsigned tid = NUM_TEST / 100 * 99;
-	report_dl << "extra,avg_latency,tail_latency" << std::endl;
+	report_dl << "extra,avg_latency,tail_latency," <<
+		strsim::quantile_sketch::percentile_header() << std::endl;
 	for (unsigned int i = 0; i <= MAXCACHE;
 			i += RAW_SIZE*CACHE_FACTOR) {
 		report_dl << i << "," <<
 			ltdata->avg_latency() << "," <<
-			ltdata->latency[tid] << "," << std::endl;
+			ltdata->latency.quantile(strsim::quantile_sketch::P99) << ",";
+		ltdata->latency.write_percentiles(report_dl);
+		report_dl << std::endl;
 		ltdata++;
 	}
 
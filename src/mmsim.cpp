@@ -6,20 +6,24 @@
  * 	- dup_factod
  * 	- cache_factor (step of increment)
  * 	- max_cachefactor
+ * Every trial is evaluated for all cache sizes at once.
  * Output:
  *  - The CMF of arrival time
  *  - The CMF of completion time with different amount of caching
  *  - The average and tail latency with diffrent amount of caching
+ *  - The p50, p90, p99, p99.9 and p99.99 latency of each setting
  *
  * */
 
 #include <iostream>
-#include <list>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include "code.h"
 #include "store.h"
+#include "cmf.h"
+#include "sketch.h"
+#include "kofn.h"
 
 #define SHAPE 3
 #define RATE 2.0
@@ -32,21 +36,22 @@
 #define VISUAL_DLCMF "visual/data/mmcmf"
 #define VISUAL_DLTL "visual/data/mmtl"
 
+/* time bins of the records, STRSIM_TIME_AXIS overrides the default of
+ * one bin per time unit up to TIME_RANGE */
+const strsim::time_axis& report_axis(void) {
+	static const strsim::time_axis axis =
+		strsim::time_axis::from_env(TIME_RANGE);
+	return axis;
+}
+
 struct loadrecord {
-	unsigned long restore [TIME_RANGE];
-	unsigned long complete [TIME_RANGE];
-	std::vector<time_t> latency;
-	loadrecord() {
-		for (int i = 0; i < TIME_RANGE; ++i) {
-			restore[i] = complete[i] = 0;
-		}
-	}
+	strsim::cmf32 restore;
+	strsim::cmf32 complete;
+	strsim::quantile_sketch latency;
+	loadrecord() : restore(report_axis()),
+		complete(report_axis()) {}
 	time_t avg_latency() {
-		time_t sumlt = 0;
-		for (time_t lt : latency) {
-			sumlt += lt;
-		}
-		return sumlt / latency.size();
+		return latency.sum() / latency.count();
 	}
 };
 
@@ -62,92 +67,86 @@ int main(int argc, char ** argv) {
 	const double DUP_FACTOR = std::stod(argv[4]);
 	
 	const unsigned int MAXCACHE = RAW_SIZE * MAX_CACHEFACTOR;
-	unsigned int cached_size = 0;
 	unsigned int num_blocks = RAW_SIZE * DUP_FACTOR;
-	unsigned long * arrival = new unsigned long [TIME_RANGE];
+	strsim::cmf arrival(report_axis());
 	
-	strsim::min_coder coder;
 	//strsim::erlang_generator eg(SHAPE, RATE, DELAY);
 	strsim::gaussian_generator gg(2.0, 1.0);
+	strsim::kofn_trial kofn;
 
-	std::list<loadrecord> data;
+	// with min_coder the data is back at the (k - C)-th arrival, so
+	// one trial gives the completion time of every cache size C
+	std::vector<unsigned int> need;
+	for (unsigned int cached_size = 0; cached_size <= MAXCACHE;
+			cached_size += (unsigned int)(RAW_SIZE * CACHE_FACTOR)) {
+		need.push_back((RAW_SIZE > cached_size) ?
+			RAW_SIZE - cached_size : 1);
+	}
+	std::vector<loadrecord> data(need.size());
 
-	while (cached_size <= MAXCACHE) {
-		loadrecord trail;
-		std::cout << "Load data with cache size " <<
-			cached_size << std::endl;
-		for (unsigned int i = 0; i < NUM_TEST; ++i) {
-			std::vector<strsim::coded_block *> blocks;
-			coder.encode(RAW_SIZE, num_blocks, blocks);
-			for (auto block : blocks) {
-				//block->arrieve_time = eg.sample();
-				block->arrieve_time = gg.sample();
-				if (block->arrieve_time >= TIME_RANGE) {
-					continue;
-				}
-				for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-					arrival[j]++;
-				}
+	std::cout << "Load data with " << need.size() << " cache sizes" <<
+		std::endl;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		kofn.clear();
+		//kofn.sample(num_blocks, eg);
+		kofn.sample(num_blocks, gg);
+		for (time_t atime : kofn.times()) {
+			arrival.add(atime);
+		}
+		kofn.order(std::min(need[0], num_blocks));
+		const std::vector<time_t> &times = kofn.times();
+		// a cache size only records the arrivals it waits for beyond
+		// the next larger one, they are summed up after the trials
+		unsigned int done = 0;
+		for (unsigned int j = need.size(); j-- > 0;) {
+			unsigned int used = std::min(need[j], num_blocks);
+			for (; done < used; ++done) {
+				data[j].restore.add(times[done]);
 			}
-			std::sort(blocks.begin(), blocks.end(),
-				[] (strsim::coded_block* f,
-						strsim::coded_block *s) -> bool {
-					return (f->arrieve_time < s->arrieve_time);
-			});
-			coder.restart();
-			unsigned int lastleft = RAW_SIZE;
-			for (auto block : blocks) {
-				unsigned int bleft = coder.decode(block);
-				time_t atime = block->arrieve_time;
-				delete block;
-				if (bleft < lastleft) {
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.restore[j] += lastleft - bleft;
-					}
-					lastleft = bleft;
-				}
-				if (bleft <= cached_size) {
-					trail.latency.push_back(atime);
-					for (time_t j = atime; j < TIME_RANGE; ++j) {
-						trail.complete[j]++;
-					}
-					break;
-				}
+			if (need[j] <= num_blocks) {
+				data[j].latency.add(times[need[j] - 1]);
+				data[j].complete.add(times[need[j] - 1]);
 			}
 		}
-		data.push_back(trail);
-		cached_size += (unsigned int)(RAW_SIZE * CACHE_FACTOR);
+	}
+	for (unsigned int j = need.size() - 1; j-- > 0;) {
+		data[j].restore += data[j + 1].restore;
 	}
 
 	std::ofstream report_cmf(VISUAL_DLCMF);
 	report_cmf << "Time,Arrival,";
 	unsigned int factor = 0;
-	for (auto& record : data) {
+	for (unsigned int i = 0; i < data.size(); ++i) {
 		report_cmf << factor << ",";
-		std::sort(record.latency.begin(), record.latency.end());
 		factor += RAW_SIZE * CACHE_FACTOR;
 	}
 	report_cmf << std::endl;
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[i]) /
-			double(arrival[TIME_RANGE-1]) << ",";
-		for (auto& record : data) {
-			report_cmf << double(record.complete[i]) /
-				double(record.complete[TIME_RANGE-1]) << ",";
+	std::vector<double> arrived = arrival.distribution();
+	std::vector<std::vector<double> > completed;
+	for (auto& record : data) {
+		completed.push_back(record.complete.distribution());
+	}
+	const strsim::time_axis &axis = report_axis();
+	for (unsigned int b = 0; b < axis.bins(); ++b) {
+		report_cmf << double(axis.last(b)) / 1000 << "," <<
+			arrived[b] << ",";
+		for (auto& complete : completed) {
+			report_cmf << complete[b] << ",";
 		}
 		report_cmf << std::endl;
 	}
 	
 	std::ofstream report_dl(VISUAL_DLTL);
 	auto ltdata = data.begin();
-	unsigned tid = NUM_TEST / 100 * 99;
-	report_dl << "extra,avg_latency,tail_latency" << std::endl;
+	report_dl << "extra,avg_latency,tail_latency," <<
+		strsim::quantile_sketch::percentile_header() << std::endl;
 	for (unsigned int i = 0; i < MAXCACHE;
 			i += RAW_SIZE*CACHE_FACTOR) {
 		report_dl << i << "," <<
 			ltdata->avg_latency() << "," <<
-			ltdata->latency[tid] << "," << std::endl;
+			ltdata->latency.quantile(strsim::quantile_sketch::P99) << ",";
+		ltdata->latency.write_percentiles(report_dl);
+		report_dl << std::endl;
 		ltdata++;
 	}
 
@@ -0,0 +1,123 @@
+/*
+ * Measure the throughput of LT and Reed-Solomon codes on real data
+ * Input:
+ * 	- raw_size
+ * 	- block_size (bytes)
+ * 	- dup_factor
+ * Output:
+ *  - Encode and decode throughput on one core, in GB of raw data per
+ *  second, for LT codes with and without inactivation decoding and for
+ *  Reed-Solomon codes when they fit in GF(2^8)
+ *
+ * */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include "code.h"
+#include "simd.h"
+
+#define ROBUST_C 0.03
+#define ROBUST_DELTA 0.5
+
+#define NUM_TEST 20
+
+typedef std::chrono::steady_clock bench_clock;
+
+double seconds(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char ** argv) {
+	if (argc != 4) {
+		std::cerr << "Usage: paybench [raw_size] [block_size] [dup_factor]"
+			<< std::endl;
+		return 1;
+	}
+	const unsigned int RAW_SIZE = std::stoi(argv[1]);
+	const unsigned int BLOCK_SIZE = std::stoi(argv[2]);
+	const double DUP_FACTOR = std::stod(argv[3]);
+	const unsigned int CODED_SIZE = RAW_SIZE * DUP_FACTOR;
+	const double GB = double(RAW_SIZE) * BLOCK_SIZE * NUM_TEST / 1e9;
+
+	std::mt19937 rng(1);
+	std::vector<uint8_t> raw(size_t(RAW_SIZE) * BLOCK_SIZE);
+	for (auto &b : raw) {
+		b = rng();
+	}
+
+	strsim::luby_coder coder(ROBUST_C, ROBUST_DELTA);
+	coder.payload(BLOCK_SIZE);
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block *> blocks;
+
+	double encode_time = 0;
+	double decode_time[2] = {0, 0};
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		// encodings checked with peeling decode in both modes
+		coder.inactivation(false);
+		coder.encode(RAW_SIZE, CODED_SIZE, arena, blocks);
+		bench_clock::time_point start = bench_clock::now();
+		coder.encode_payload(raw.data(), arena);
+		encode_time += seconds(start);
+		std::shuffle(blocks.begin(), blocks.end(), rng);
+		for (int mode = 0; mode < 2; ++mode) {
+			coder.inactivation(mode == 1);
+			coder.restart();
+			start = bench_clock::now();
+			for (auto block : blocks) {
+				coder.decode(block);
+				if (coder.has_finished()) {
+					break;
+				}
+			}
+			decode_time[mode] += seconds(start);
+			if (!coder.has_finished() ||
+					memcmp(coder.data(), raw.data(), raw.size()) != 0) {
+				failed++;
+			}
+		}
+	}
+
+	std::cout << "xor kernel = " << strsim::xor_kernel() << std::endl;
+	std::cout << "encode GB/s = " << GB / encode_time << std::endl;
+	std::cout << "decode GB/s peeling = " << GB / decode_time[0] << std::endl;
+	std::cout << "decode GB/s inactivation = " <<
+		GB / decode_time[1] << std::endl;
+
+	if (CODED_SIZE > strsim::rs_coder::MAX_BLOCKS) {
+		std::cout << "rs skipped, more than " <<
+			strsim::rs_coder::MAX_BLOCKS << " coded blocks" << std::endl;
+	}else{
+		strsim::rs_coder rs;
+		rs.payload(BLOCK_SIZE);
+		double rs_encode = 0;
+		double rs_decode = 0;
+		for (unsigned int i = 0; i < NUM_TEST; ++i) {
+			rs.encode(RAW_SIZE, CODED_SIZE, arena, blocks);
+			bench_clock::time_point start = bench_clock::now();
+			rs.encode_payload(raw.data(), arena);
+			rs_encode += seconds(start);
+			std::shuffle(blocks.begin(), blocks.end(), rng);
+			start = bench_clock::now();
+			for (auto block : blocks) {
+				if (rs.decode(block) == 0) {
+					break;
+				}
+			}
+			rs_decode += seconds(start);
+			if (memcmp(rs.data(), raw.data(), raw.size()) != 0) {
+				failed++;
+			}
+		}
+		std::cout << "gf kernel = " << strsim::gf_kernel() << std::endl;
+		std::cout << "rs encode GB/s = " << GB / rs_encode << std::endl;
+		std::cout << "rs decode GB/s = " << GB / rs_decode << std::endl;
+	}
+	std::cout << "failed decodes = " << failed << std::endl;
+	return failed != 0;
+}
@@ -0,0 +1,81 @@
+#include "pool.h"
+#include <thread>
+#include <cstdint>
+
+/* one worker per core, at least one if the count is unknown */
+static unsigned int worker_count(unsigned int workers) {
+	if (workers == 0) {
+		workers = std::thread::hardware_concurrency();
+	}
+	return (workers == 0) ? 1 : workers;
+}
+
+strsim::task_pool::task_pool(unsigned int workers) :
+		_workers(worker_count(workers)), _queues(_workers), _done(0) {}
+
+void strsim::task_pool::run(size_type count, const task_type &task,
+		const progress_type &progress) {
+	_done = 0;
+	for (unsigned int w = 0; w < _workers; ++w) {
+		size_type begin = size_type(uint64_t(count) * w / _workers);
+		size_type end = size_type(uint64_t(count) * (w + 1) / _workers);
+		for (size_type id = begin; id < end; ++id) {
+			_queues[w].tasks.push_back(id);
+		}
+	}
+	std::vector<std::thread> threads;
+	for (unsigned int w = 1; w < _workers; ++w) {
+		threads.push_back(std::thread(&task_pool::work, this, w,
+				std::cref(task), std::cref(progress)));
+	}
+	work(0, task, progress);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+bool strsim::task_pool::next(unsigned int worker, size_type &id) {
+	{
+		std::lock_guard<std::mutex> guard(_queues[worker].lock);
+		if (!_queues[worker].tasks.empty()) {
+			id = _queues[worker].tasks.front();
+			_queues[worker].tasks.pop_front();
+			return true;
+		}
+	}
+	// steal the last task of the longest queue, sizes are only a hint
+	// as they are read without locking every queue at once
+	while (true) {
+		unsigned int victim = _workers;
+		size_t longest = 0;
+		for (unsigned int w = 0; w < _workers; ++w) {
+			std::lock_guard<std::mutex> guard(_queues[w].lock);
+			if (_queues[w].tasks.size() > longest) {
+				longest = _queues[w].tasks.size();
+				victim = w;
+			}
+		}
+		if (victim == _workers) {
+			return false;
+		}
+		std::lock_guard<std::mutex> guard(_queues[victim].lock);
+		if (!_queues[victim].tasks.empty()) {
+			id = _queues[victim].tasks.back();
+			_queues[victim].tasks.pop_back();
+			return true;
+		}
+	}
+}
+
+void strsim::task_pool::work(unsigned int worker, const task_type &task,
+		const progress_type &progress) {
+	size_type id;
+	while (next(worker, id)) {
+		task(id, worker);
+		std::lock_guard<std::mutex> guard(_progress_lock);
+		_done++;
+		if (progress) {
+			progress(_done);
+		}
+	}
+}
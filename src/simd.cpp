@@ -0,0 +1,476 @@
+#include "simd.h"
+#include <cstring>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+	typedef void (*xor_fn)(uint8_t *, const uint8_t *, size_t);
+
+	void xor_word(uint8_t * dst, const uint8_t * src, size_t len) {
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8) {
+			uint64_t d, s;
+			memcpy(&d, dst + i, 8);
+			memcpy(&s, src + i, 8);
+			d ^= s;
+			memcpy(dst + i, &d, 8);
+		}
+		for (; i < len; ++i) {
+			dst[i] ^= src[i];
+		}
+	}
+
+#ifdef SIMD_X86
+	__attribute__((target("sse2")))
+	void xor_sse2(uint8_t * dst, const uint8_t * src, size_t len) {
+		size_t i = 0;
+		for (; i + 64 <= len; i += 64) {
+			for (size_t j = i; j < i + 64; j += 16) {
+				__m128i d = _mm_loadu_si128((const __m128i *)(dst + j));
+				__m128i s = _mm_loadu_si128((const __m128i *)(src + j));
+				_mm_storeu_si128((__m128i *)(dst + j), _mm_xor_si128(d, s));
+			}
+		}
+		for (; i + 16 <= len; i += 16) {
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+			__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, s));
+		}
+		xor_word(dst + i, src + i, len - i);
+	}
+
+	__attribute__((target("avx2")))
+	void xor_avx2(uint8_t * dst, const uint8_t * src, size_t len) {
+		size_t i = 0;
+		for (; i + 128 <= len; i += 128) {
+			for (size_t j = i; j < i + 128; j += 32) {
+				__m256i d = _mm256_loadu_si256((const __m256i *)(dst + j));
+				__m256i s = _mm256_loadu_si256((const __m256i *)(src + j));
+				_mm256_storeu_si256((__m256i *)(dst + j),
+						_mm256_xor_si256(d, s));
+			}
+		}
+		for (; i + 32 <= len; i += 32) {
+			__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+			__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, s));
+		}
+		xor_word(dst + i, src + i, len - i);
+	}
+#endif
+
+	struct xor_kernel_t {
+		xor_fn fn;
+		const char * name;
+		xor_kernel_t() : fn(xor_word), name("word") {
+#ifdef SIMD_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				fn = xor_avx2;
+				name = "avx2";
+			}else if (__builtin_cpu_supports("sse2")) {
+				fn = xor_sse2;
+				name = "sse2";
+			}
+#endif
+		}
+	};
+
+	const xor_kernel_t& kernel(void) {
+		static const xor_kernel_t k;
+		return k;
+	}
+
+	struct gf_tables_t {
+		uint8_t exp[512];
+		uint8_t log[256];
+		gf_tables_t() {
+			unsigned int x = 1;
+			for (int i = 0; i < 255; ++i) {
+				exp[i] = exp[i + 255] = x;
+				log[x] = i;
+				x <<= 1;
+				if (x & 0x100) {
+					x ^= 0x11d;
+				}
+			}
+			exp[510] = exp[0];
+			exp[511] = exp[1];
+			log[0] = 0;
+		}
+	};
+
+	const gf_tables_t& gf_tables(void) {
+		static const gf_tables_t t;
+		return t;
+	}
+
+	typedef void (*gf_fn)(uint8_t *, const uint8_t *, const uint8_t *,
+			const uint8_t *, size_t);
+
+	// lo[x] = c * x and hi[x] = c * (x << 4) for every nibble x
+	void gf_table(uint8_t * dst, const uint8_t * src, const uint8_t * lo,
+			const uint8_t * hi, size_t len) {
+		for (size_t i = 0; i < len; ++i) {
+			dst[i] ^= lo[src[i] & 0x0f] ^ hi[src[i] >> 4];
+		}
+	}
+
+#ifdef SIMD_X86
+	__attribute__((target("ssse3")))
+	void gf_ssse3(uint8_t * dst, const uint8_t * src, const uint8_t * lo,
+			const uint8_t * hi, size_t len) {
+		const __m128i tlo = _mm_loadu_si128((const __m128i *)lo);
+		const __m128i thi = _mm_loadu_si128((const __m128i *)hi);
+		const __m128i mask = _mm_set1_epi8(0x0f);
+		size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+			__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+			__m128i h = _mm_shuffle_epi8(thi,
+					_mm_and_si128(_mm_srli_epi64(s, 4), mask));
+			d = _mm_xor_si128(d, _mm_xor_si128(l, h));
+			_mm_storeu_si128((__m128i *)(dst + i), d);
+		}
+		gf_table(dst + i, src + i, lo, hi, len - i);
+	}
+
+	__attribute__((target("avx2")))
+	void gf_avx2(uint8_t * dst, const uint8_t * src, const uint8_t * lo,
+			const uint8_t * hi, size_t len) {
+		const __m256i tlo = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i *)lo));
+		const __m256i thi = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i *)hi));
+		const __m256i mask = _mm256_set1_epi8(0x0f);
+		size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+			__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+			__m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+			__m256i h = _mm256_shuffle_epi8(thi,
+					_mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+			d = _mm256_xor_si256(d, _mm256_xor_si256(l, h));
+			_mm256_storeu_si256((__m256i *)(dst + i), d);
+		}
+		gf_table(dst + i, src + i, lo, hi, len - i);
+	}
+#endif
+
+	struct gf_kernel_t {
+		gf_fn fn;
+		const char * name;
+		gf_kernel_t() : fn(gf_table), name("table") {
+#ifdef SIMD_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				fn = gf_avx2;
+				name = "avx2";
+			}else if (__builtin_cpu_supports("ssse3")) {
+				fn = gf_ssse3;
+				name = "ssse3";
+			}
+#endif
+		}
+	};
+
+	const gf_kernel_t& mul_kernel(void) {
+		static const gf_kernel_t k;
+		return k;
+	}
+
+	// Vector math for the random generators. Every kernel runs the same
+	// sequence of correctly rounded operations (no fused multiply-add),
+	// so a kernel gives bit for bit the same samples as the scalar one.
+	const double TWO_M32 = 1.0 / 4294967296.0;
+	const double TWO_31 = 2147483648.0;
+	const double TWO_52 = 4503599627370496.0;
+	// adding 1.5 * 2^52 rounds to an integer kept in the low bits
+	const double ROUND = 6755399441055744.0;
+	const double LN2 = 0.6931471805599453;
+	const double SQRT2 = 1.4142135623730951;
+	const double HALF_PI = 1.5707963267948966;
+	// 1 / (2i + 1) for log(m) = 2 atanh((m - 1) / (m + 1))
+	const double LOG_C[7] = {1.0 / 3, 1.0 / 5, 1.0 / 7, 1.0 / 9,
+		1.0 / 11, 1.0 / 13, 1.0 / 15};
+	// Taylor coefficients of sin and cos on [-pi/4, pi/4]
+	const double SIN_C[6] = {-1.0 / 6, 1.0 / 120, -1.0 / 5040,
+		1.0 / 362880, -1.0 / 39916800, 1.0 / 6227020800};
+	const double COS_C[7] = {-1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320,
+		-1.0 / 3628800, 1.0 / 479001600, -1.0 / 87178291200};
+
+	// uniform number in (0, 1) from a word
+	inline double uniform_open(uint32_t w) {
+		return (double(w) + 0.5) * TWO_M32;
+	}
+
+	// ln(x) of a positive normal number, x = 2^e * m with m around 1
+	double log_scalar(double x) {
+		uint64_t bits;
+		memcpy(&bits, &x, 8);
+		uint64_t eb = (bits >> 52) | 0x4330000000000000;
+		uint64_t mb = (bits & 0x000fffffffffffff) | 0x3ff0000000000000;
+		double e, m;
+		memcpy(&e, &eb, 8);
+		memcpy(&m, &mb, 8);
+		e = (e - TWO_52) - 1023.0;
+		if (m > SQRT2) {
+			m = m * 0.5;
+			e = e + 1.0;
+		}
+		double s = (m - 1.0) / (m + 1.0);
+		double z = s * s;
+		double p = LOG_C[6];
+		for (int i = 5; i >= 0; --i) {
+			p = p * z + LOG_C[i];
+		}
+		double t = s + s;
+		return e * LN2 + (t + t * (z * p));
+	}
+
+	// sin and cos of 2 pi u, u = q / 4 + x / (2 pi) with |x| <= pi / 4
+	void sincos_scalar(double u, double &s, double &c) {
+		double t = u * 4.0;
+		double r = t + ROUND;
+		uint64_t q;
+		memcpy(&q, &r, 8);
+		double x = (t - (r - ROUND)) * HALF_PI;
+		double z = x * x;
+		double ps = SIN_C[5];
+		for (int i = 4; i >= 0; --i) {
+			ps = ps * z + SIN_C[i];
+		}
+		double pc = COS_C[6];
+		for (int i = 5; i >= 0; --i) {
+			pc = pc * z + COS_C[i];
+		}
+		double sx = x + x * (z * ps);
+		double cx = 1.0 + z * pc;
+		s = (q & 1) ? cx : sx;
+		c = (q & 1) ? sx : cx;
+		if (q & 2) {
+			s = -s;
+		}
+		if ((q + 1) & 2) {
+			c = -c;
+		}
+	}
+
+	typedef void (*normal_fn)(const uint32_t *, double *, size_t);
+	typedef void (*exponential_fn)(const uint32_t *, double *, size_t);
+
+	// pair i of the samples, see normal_fill
+	inline void normal_pair(const uint32_t * words, double * out,
+			size_t pairs, size_t i) {
+		double r = std::sqrt(log_scalar(uniform_open(words[i])) * -2.0);
+		double s, c;
+		sincos_scalar(double(words[pairs + i]) * TWO_M32, s, c);
+		out[i] = r * c;
+		out[pairs + i] = r * s;
+	}
+
+	void normal_scalar(const uint32_t * words, double * out, size_t pairs) {
+		for (size_t i = 0; i < pairs; ++i) {
+			normal_pair(words, out, pairs, i);
+		}
+	}
+
+	void exponential_scalar(const uint32_t * words, double * out,
+			size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			out[i] = -log_scalar(uniform_open(words[i]));
+		}
+	}
+
+#ifdef SIMD_X86
+	// 4 words as doubles, exact for the whole unsigned range
+	__attribute__((target("avx2")))
+	inline __m256d word_avx2(const uint32_t * words) {
+		__m128i w = _mm_loadu_si128((const __m128i *)words);
+		w = _mm_xor_si128(w, _mm_set1_epi32(0x80000000));
+		return _mm256_add_pd(_mm256_cvtepi32_pd(w),
+				_mm256_set1_pd(TWO_31));
+	}
+
+	__attribute__((target("avx2")))
+	inline __m256d log_avx2(__m256d x) {
+		__m256i bits = _mm256_castpd_si256(x);
+		__m256d e = _mm256_castsi256_pd(_mm256_or_si256(
+				_mm256_srli_epi64(bits, 52),
+				_mm256_set1_epi64x(0x4330000000000000)));
+		__m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+				_mm256_and_si256(bits,
+					_mm256_set1_epi64x(0x000fffffffffffff)),
+				_mm256_set1_epi64x(0x3ff0000000000000)));
+		e = _mm256_sub_pd(_mm256_sub_pd(e, _mm256_set1_pd(TWO_52)),
+				_mm256_set1_pd(1023.0));
+		__m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(SQRT2), _CMP_GT_OQ);
+		m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+		e = _mm256_blendv_pd(e, _mm256_add_pd(e, _mm256_set1_pd(1.0)), big);
+		__m256d one = _mm256_set1_pd(1.0);
+		__m256d s = _mm256_div_pd(_mm256_sub_pd(m, one),
+				_mm256_add_pd(m, one));
+		__m256d z = _mm256_mul_pd(s, s);
+		__m256d p = _mm256_set1_pd(LOG_C[6]);
+		for (int i = 5; i >= 0; --i) {
+			p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(LOG_C[i]));
+		}
+		__m256d t = _mm256_add_pd(s, s);
+		return _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(LN2)),
+				_mm256_add_pd(t, _mm256_mul_pd(t, _mm256_mul_pd(z, p))));
+	}
+
+	__attribute__((target("avx2")))
+	inline void sincos_avx2(__m256d u, __m256d &s, __m256d &c) {
+		__m256d t = _mm256_mul_pd(u, _mm256_set1_pd(4.0));
+		__m256d r = _mm256_add_pd(t, _mm256_set1_pd(ROUND));
+		__m256i q = _mm256_castpd_si256(r);
+		__m256d x = _mm256_mul_pd(_mm256_sub_pd(t,
+					_mm256_sub_pd(r, _mm256_set1_pd(ROUND))),
+				_mm256_set1_pd(HALF_PI));
+		__m256d z = _mm256_mul_pd(x, x);
+		__m256d ps = _mm256_set1_pd(SIN_C[5]);
+		for (int i = 4; i >= 0; --i) {
+			ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C[i]));
+		}
+		__m256d pc = _mm256_set1_pd(COS_C[6]);
+		for (int i = 5; i >= 0; --i) {
+			pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C[i]));
+		}
+		__m256d sx = _mm256_add_pd(x, _mm256_mul_pd(x, _mm256_mul_pd(z, ps)));
+		__m256d cx = _mm256_add_pd(_mm256_set1_pd(1.0),
+				_mm256_mul_pd(z, pc));
+		// blendv and the sign flips only look at the top bit
+		__m256d odd = _mm256_castsi256_pd(_mm256_slli_epi64(q, 63));
+		__m256i two = _mm256_set1_epi64x(2);
+		__m256d sneg = _mm256_castsi256_pd(_mm256_slli_epi64(
+				_mm256_and_si256(q, two), 62));
+		__m256d cneg = _mm256_castsi256_pd(_mm256_slli_epi64(
+				_mm256_and_si256(_mm256_add_epi64(q,
+						_mm256_set1_epi64x(1)), two), 62));
+		s = _mm256_xor_pd(_mm256_blendv_pd(sx, cx, odd), sneg);
+		c = _mm256_xor_pd(_mm256_blendv_pd(cx, sx, odd), cneg);
+	}
+
+	__attribute__((target("avx2")))
+	void normal_avx2(const uint32_t * words, double * out, size_t pairs) {
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d scale = _mm256_set1_pd(TWO_M32);
+		size_t i = 0;
+		for (; i + 4 <= pairs; i += 4) {
+			__m256d u1 = _mm256_mul_pd(_mm256_add_pd(word_avx2(words + i),
+						half), scale);
+			__m256d u2 = _mm256_mul_pd(word_avx2(words + pairs + i), scale);
+			__m256d r = _mm256_sqrt_pd(_mm256_mul_pd(log_avx2(u1),
+						_mm256_set1_pd(-2.0)));
+			__m256d s, c;
+			sincos_avx2(u2, s, c);
+			_mm256_storeu_pd(out + i, _mm256_mul_pd(r, c));
+			_mm256_storeu_pd(out + pairs + i, _mm256_mul_pd(r, s));
+		}
+		for (; i < pairs; ++i) {
+			normal_pair(words, out, pairs, i);
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void exponential_avx2(const uint32_t * words, double * out,
+			size_t count) {
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d scale = _mm256_set1_pd(TWO_M32);
+		const __m256d zero = _mm256_setzero_pd();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m256d u = _mm256_mul_pd(_mm256_add_pd(word_avx2(words + i),
+						half), scale);
+			_mm256_storeu_pd(out + i, _mm256_sub_pd(zero, log_avx2(u)));
+		}
+		exponential_scalar(words + i, out + i, count - i);
+	}
+#endif
+
+	struct math_kernel_t {
+		normal_fn normal;
+		exponential_fn exponential;
+		const char * name;
+		math_kernel_t() : normal(normal_scalar),
+				exponential(exponential_scalar), name("scalar") {
+#ifdef SIMD_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				normal = normal_avx2;
+				exponential = exponential_avx2;
+				name = "avx2";
+			}
+#endif
+		}
+	};
+
+	const math_kernel_t& math_kernels(void) {
+		static const math_kernel_t k;
+		return k;
+	}
+
+}
+
+void strsim::xor_block(uint8_t * dst, const uint8_t * src, size_t len) {
+	kernel().fn(dst, src, len);
+}
+
+const char * strsim::xor_kernel(void) {
+	return kernel().name;
+}
+
+uint8_t strsim::gf_mul(uint8_t a, uint8_t b) {
+	if (a == 0 || b == 0) {
+		return 0;
+	}
+	const gf_tables_t &t = gf_tables();
+	return t.exp[t.log[a] + t.log[b]];
+}
+
+uint8_t strsim::gf_inv(uint8_t a) {
+	const gf_tables_t &t = gf_tables();
+	return t.exp[255 - t.log[a]];
+}
+
+void strsim::gf_mul_add(uint8_t * dst, const uint8_t * src, uint8_t c,
+		size_t len) {
+	if (c == 0) {
+		return;
+	}
+	if (c == 1) {
+		xor_block(dst, src, len);
+		return;
+	}
+	uint8_t lo[16], hi[16];
+	for (int x = 0; x < 16; ++x) {
+		lo[x] = gf_mul(c, x);
+		hi[x] = gf_mul(c, x << 4);
+	}
+	mul_kernel().fn(dst, src, lo, hi, len);
+}
+
+const char * strsim::gf_kernel(void) {
+	return mul_kernel().name;
+}
+
+void strsim::normal_fill(const uint32_t * words, double * out,
+		size_t pairs) {
+	math_kernels().normal(words, out, pairs);
+}
+
+void strsim::exponential_fill(const uint32_t * words, double * out,
+		size_t count) {
+	math_kernels().exponential(words, out, count);
+}
+
+const char * strsim::math_kernel(void) {
+	return math_kernels().name;
+}
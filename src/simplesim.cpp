@@ -21,6 +21,8 @@
 #include <string>
 #include "code.h"
 #include "store.h"
+#include "cmf.h"
+#include "arrival.h"
 
 #define SHAPE 3
 #define RATE 2.0
@@ -40,8 +42,6 @@
 #define VISUAL_CMFTAIL "visual/data/cmftail"
 
 struct loadrecord {
-	// blocks used for reconstruct the original data
-	std::vector<strsim::coded_block*> blocks;
 	time_t ftime; 	// Original latency
 	time_t rtime; 	// Latency of caching the several last blocks
 	time_t mtime; 	// Latency of trying to cache and use block from
@@ -65,19 +65,23 @@ int main(int argc, char ** argv) {
 	
 	//strsim::luby_coder coder;
 	strsim::min_coder coder;
-	//strsim::erlang_generator eg(SHAPE, RATE, DELAY);
-	strsim::gaussian_generator gg(SHAPE, RATE, DELAY);
+	strsim::erlang_generator eg(SHAPE, RATE, DELAY);
+	// blocks used for reconstruct the original data
+	strsim::block_arena arena;
+	std::vector<strsim::coded_block*> blocks;
+	strsim::arrival_queue queue;
+	std::vector<strsim::rnd_generator::value_type> draw;
 	
 	// number of block arrival after a certain point of time
-	unsigned long * arrival = new unsigned long [TIME_RANGE];
+	strsim::cmf arrival(TIME_RANGE);
 	// number of block constructed after a certain point of time
-	unsigned long * complete = new unsigned long [TIME_RANGE];
+	strsim::cmf complete(TIME_RANGE);
 	// number of block on the cache use for reconstruction
 	// after a certain point of time
-	unsigned long * rcache = new unsigned long [TIME_RANGE];
+	strsim::cmf rcache(TIME_RANGE);
 	// number of original data restored after a certain point
 	// of time
-	unsigned long * constructed = new unsigned long [TIME_RANGE];
+	strsim::cmf constructed(TIME_RANGE);
 	// Assume we restore block N-th and (N+1)-th at t0 and t1,
 	// then we want to know the number of blocks loaded between
 	// t0 and t1 
@@ -85,12 +89,6 @@ int main(int argc, char ** argv) {
 	// The number of block we can reconstruct if we successfully
 	// fetch a new block from storage system
 	unsigned long * nrestore = new unsigned long [BLOCK_RANGE];
-	for (int i = 0; i < TIME_RANGE; ++i) {
-		arrival[i] = 0;
-		complete[i] = 0;
-		rcache[i] = 0;
-		constructed[i] = 0;
-	}
 	for (int i = 0; i < BLOCK_RANGE; ++i) {
 		nwait[i] = 0;
 		nrestore[i] = 0;
@@ -104,33 +102,26 @@ int main(int argc, char ** argv) {
 			std::cout << "Processed " <<
 				(i+1) / (NUM_TEST / 100) << "%" << std::endl;
 		}
-		coder.encode(RAW_SIZE, CODED_SIZE, trail.blocks);
-		for (auto block : trail.blocks) {
-			block->arrieve_time = eg.sample();
-			if (block->arrieve_time >= TIME_RANGE) {
-				continue;
-			}
-			for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-				arrival[j]++;
-			}
+		coder.encode(RAW_SIZE, CODED_SIZE, arena, blocks);
+		strsim::sample_arrivals(eg, blocks.data(), blocks.size(), draw);
+		for (auto block : blocks) {
+			arrival.add(block->arrieve_time);
 		}
-		std::sort(trail.blocks.begin(), trail.blocks.end(),
-				[] (strsim::coded_block* f,
-				strsim::coded_block* s) -> bool {
-					return (f->arrieve_time < s->arrieve_time);
-				});
+		queue.assign(blocks.data(), blocks.size());
 		coder.restart();
 		bool wait = false;
-		trail.mtime = trail.blocks[RAW_SIZE - CACHED_SIZE]->arrieve_time;
 		unsigned int lastleft = RAW_SIZE;
 		unsigned int waitcount = 0;
-		for (auto block : trail.blocks) {
+		unsigned int consumed = 0;
+		while (!queue.empty()) {
+			strsim::coded_block * block = queue.pop();
+			if (consumed++ == RAW_SIZE - CACHED_SIZE) {
+				trail.mtime = block->arrieve_time;
+			}
 			unsigned int bleft = coder.decode(block);
 			trail.blockleft.push_back(bleft);
 			if (bleft < lastleft) {
-				for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-					complete[j] += lastleft - bleft;
-				}
+				complete.add(block->arrieve_time, lastleft - bleft);
 				if (lastleft - bleft - 1 < BLOCK_RANGE) {
 					nrestore[lastleft - bleft - 1]++;
 				}else{
@@ -149,19 +140,20 @@ int main(int argc, char ** argv) {
 			if (bleft <= CACHED_SIZE && !wait) {
 				trail.rtime = block->arrieve_time;
 				wait = true;
-				for (unsigned int j = block->arrieve_time;
-						j < TIME_RANGE; ++j) {
-					rcache[j] += CACHED_SIZE;
-				}
+				rcache.add(block->arrieve_time, CACHED_SIZE);
 			}
 			if (coder.has_finished()) {
-				for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-					constructed[j]++;
-				}
+				constructed.add(block->arrieve_time);
 				trail.ftime = block->arrieve_time;
 				break;
 			}
 		}
+		// without cache, the arrival after the first k comes after the
+		// data is back
+		while (consumed <= RAW_SIZE - CACHED_SIZE) {
+			trail.mtime = queue.pop()->arrieve_time;
+			consumed++;
+		}
 		data.push_back(trail);
 	}
 	double tf = 0;
@@ -232,27 +224,31 @@ int main(int argc, char ** argv) {
 	std::ofstream report_fr(VISUAL_FR);
 	std::string sthead = "Time, \% of blocks arrived,"
 		"\% of blocks constructed, Finish, Finish w. caching";
+	std::vector<unsigned long> arrived = arrival.cumulative();
+	std::vector<unsigned long> completed = complete.cumulative();
+	std::vector<unsigned long> cached = rcache.cumulative();
+	std::vector<unsigned long> restored = constructed.cumulative();
 	report_cmf << sthead << std::endl;
 	for (time_t i = 0; i < TIME_RANGE; ++i) {
 		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[i]) / double(arrival[TIME_RANGE-1]) << "," <<
-			double(complete[i]) / double(complete[TIME_RANGE-1]) << "," <<
-			double(rcache[i]) / double(rcache[TIME_RANGE-1]) << "," <<
-			double(constructed[i]) /
-			double(constructed[TIME_RANGE-1]) << "," <<
+			double(arrived[i]) / double(arrived[TIME_RANGE-1]) << "," <<
+			double(completed[i]) / double(completed[TIME_RANGE-1]) << "," <<
+			double(cached[i]) / double(cached[TIME_RANGE-1]) << "," <<
+			double(restored[i]) /
+			double(restored[TIME_RANGE-1]) << "," <<
 			std::endl;
 	}
 	report_dist << sthead << std::endl;
 	for (time_t i = 1; i < TIME_RANGE; ++i) {
 		report_dist << double(i) / 1000 << "," <<
-			double(arrival[i] - arrival[i-1]) /
-			double(arrival[TIME_RANGE-1]) * TIME_RANGE << "," <<
-			double(complete[i] - complete[i-1]) /
-			double(complete[TIME_RANGE-1]) * TIME_RANGE << "," <<
-			double(rcache[i] - rcache[i-1]) /
-			double(rcache[TIME_RANGE-1]) << "," <<
-			double(constructed[i] - constructed[i-1]) /
-			double(constructed[TIME_RANGE-1]) << "," <<
+			double(arrived[i] - arrived[i-1]) /
+			double(arrived[TIME_RANGE-1]) * TIME_RANGE << "," <<
+			double(completed[i] - completed[i-1]) /
+			double(completed[TIME_RANGE-1]) * TIME_RANGE << "," <<
+			double(cached[i] - cached[i-1]) /
+			double(cached[TIME_RANGE-1]) << "," <<
+			double(restored[i] - restored[i-1]) /
+			double(restored[TIME_RANGE-1]) << "," <<
 			std::endl;	
 	}
 	report_fr << "Num, No. Block per Interval, Num. Block Restored" <<
@@ -264,53 +260,34 @@ int main(int argc, char ** argv) {
 	report_dist.close();
 	report_cmf.close();
 	report_fr.close();
-	delete[] arrival;
-	delete[] complete;
-	delete[] rcache;
 	delete[] nwait;
 	delete[] nrestore;
 
 	/* Rerun the last 10% of trails to investigate the case */
-	arrival = new unsigned long [TIME_RANGE];
-	complete = new unsigned long [TIME_RANGE];
-	constructed = new unsigned long [TIME_RANGE];
-	for (unsigned int i = 0; i < TIME_RANGE; ++i) {
-		arrival[i] = 0;
-		complete[i] = 0;
-		constructed[i] = 0;
-	}
+	arrival.clear();
+	complete.clear();
+	constructed.clear();
 	unsigned int ttl = 10;
 	while (ttl > 0) {
 		for (unsigned int i = NUM_TEST / 100 * 90; i < NUM_TEST; ++i) {
 		//for (unsigned int i = 0; i < NUM_TEST / 10; ++i) {
-			for (auto block : data[i].blocks) {
-				block->arrieve_time = eg.sample();
-				if (block->arrieve_time >= TIME_RANGE) {
-					continue;
-				}
-				for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-					arrival[j]++;
-				}
+			coder.encode(RAW_SIZE, CODED_SIZE, arena, blocks);
+			strsim::sample_arrivals(eg, blocks.data(), blocks.size(), draw);
+			for (auto block : blocks) {
+				arrival.add(block->arrieve_time);
 			}
-			std::sort(data[i].blocks.begin(), data[i].blocks.end(),
-					[] (strsim::coded_block* f,
-						strsim::coded_block* s) -> bool {
-					return (f->arrieve_time < s->arrieve_time);
-					});
+			queue.assign(blocks.data(), blocks.size());
 			coder.restart();
 			unsigned int lastleft = RAW_SIZE;
-			for (auto block : data[i].blocks) {
+			while (!queue.empty()) {
+				strsim::coded_block * block = queue.pop();
 				unsigned int bleft = coder.decode(block);
 				if (bleft < lastleft) {
-					for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-						complete[j] += lastleft - bleft;
-					}
+					complete.add(block->arrieve_time, lastleft - bleft);
 					lastleft = bleft;
 				}
 				if (coder.has_finished()) {
-					for (time_t j = block->arrieve_time; j < TIME_RANGE; ++j) {
-						constructed[j]++;
-					}
+					constructed.add(block->arrieve_time);
 					break;
 				}
 			}
@@ -319,11 +296,14 @@ int main(int argc, char ** argv) {
 	}
 	report_cmf.open(VISUAL_CMFTAIL);
 	report_cmf << "Time, Arrival, Complete, Constructed" << std::endl;
+	arrived = arrival.cumulative();
+	completed = complete.cumulative();
+	restored = constructed.cumulative();
 	for (time_t i = 0; i < TIME_RANGE; ++i) {
 		report_cmf << double(i) / 1000 << "," <<
-			double(arrival[i]) / double(arrival[TIME_RANGE-1]) << "," <<
-			double(complete[i]) / double(complete[TIME_RANGE-1]) << "," <<
-			double(constructed[i]) / double(constructed[TIME_RANGE-1]) << "," <<
+			double(arrived[i]) / double(arrived[TIME_RANGE-1]) << "," <<
+			double(completed[i]) / double(completed[TIME_RANGE-1]) << "," <<
+			double(restored[i]) / double(restored[TIME_RANGE-1]) << "," <<
 			std::endl;	
 	}
 	report_cmf.close();
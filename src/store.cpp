@@ -1,33 +1,290 @@
 #include "store.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
 
 #define SCALE 1000
+// random words drawn at once by the batch samplers
+#define BATCH 512
+// pairs of words per Box-Muller group of the gaussian batches, a fixed
+// group keeps a batch the start of any longer one
+#define PAIRS 8
+// candidates per group of the gamma batches
+#define CANDIDATES 16
 
-void strsim::erlang_generator::setup(unsigned int shape,
+/* uniform number in (0, 1) from a random word */
+static inline double uniform_open(uint32_t w) {
+	return (double(w) + 0.5) / 4294967296.0;
+}
+
+/* Marsaglia-Tsang step: turn a standard normal x and a uniform u into a
+ * Gamma(d + 1/3, 1) sample g, false if the candidate is rejected */
+static inline bool gamma_accept(double d, double c, double x, double u,
+		double &g) {
+	double v = 1 + c * x;
+	if (v <= 0) {
+		return false;
+	}
+	v = v * v * v;
+	double x2 = x * x;
+	// the squeeze accepts most candidates without taking a log
+	if (u < 1 - 0.0331 * x2 * x2 ||
+			std::log(u) < 0.5 * x2 + d * (1 - v + std::log(v))) {
+		g = d * v;
+		return true;
+	}
+	return false;
+}
+
+/* Gamma(d + 1/3, 1) sample from single draws of an engine, x becomes
+ * sign * x and u becomes 1 - u when flip is set */
+static double gamma_draw(strsim::philox &gen, double d, double c,
+		bool flip) {
+	std::normal_distribution<double> normal(0, 1);
+	std::uniform_real_distribution<double> dist(0, 1);
+	double g, x, u;
+	do {
+		x = normal(gen);
+		u = dist(gen);
+	} while (!gamma_accept(d, c, flip ? -x : x, flip ? 1 - u : u, g));
+	return g;
+}
+
+/* Regularized lower incomplete gamma function P(a, x), by its series
+ * below a + 1 and its continued fraction (modified Lentz) above */
+static double gamma_p(double a, double x) {
+	const double eps = 1e-15;
+	const double tiny = 1e-300;
+	if (x <= 0) {
+		return 0;
+	}
+	double front = std::exp(a * std::log(x) - x - std::lgamma(a));
+	if (x < a + 1) {
+		double term = 1 / a;
+		double sum = term;
+		for (double n = a + 1; std::fabs(term) > std::fabs(sum) * eps;
+				n += 1) {
+			term *= x / n;
+			sum += term;
+		}
+		return std::min(1.0, sum * front);
+	}
+	double b = x + 1 - a;
+	double c = 1 / tiny;
+	double d = 1 / b;
+	double h = d;
+	for (int i = 1; i < 100000; ++i) {
+		double an = -i * (i - a);
+		b += 2;
+		d = an * d + b;
+		d = (std::fabs(d) < tiny) ? tiny : d;
+		c = b + an / c;
+		c = (std::fabs(c) < tiny) ? tiny : c;
+		d = 1 / d;
+		double delta = d * c;
+		h *= delta;
+		if (std::fabs(delta - 1) < eps) {
+			break;
+		}
+	}
+	return std::max(0.0, 1 - front * h);
+}
+
+void strsim::erlang_generator::setup(double shape,
 		double rate, double delay) {
 	_shape = shape;
 	_rate = rate;
 	_delay = delay;
+	double a = (shape < 1) ? shape + 1 : shape;
+	_d = a - 1.0 / 3;
+	_c = 1 / std::sqrt(9 * _d);
+	tilt(_theta);
+}
 
+void strsim::erlang_generator::tilt(double theta) {
+	_theta = theta;
+	_tilted_rate = (_shape > 0) ? _rate / (1 + theta / std::sqrt(_shape)) :
+		_rate;
 }
+
 strsim::erlang_generator::value_type strsim::erlang_generator::sample(void) {
-	double eln = 1.0;
-	for (unsigned int i = 0; i < _shape; ++i) {
-		eln *= _dist(_gen);
+	if (_shape <= 0) {
+		return SCALE * _delay;
+	}
+	double g, x, u;
+	do {
+		x = _normal(_gen);
+		u = _dist(_gen);
+	} while (!gamma_accept(_d, _c, _antithetic ? -x : x,
+			_antithetic ? 1 - u : u, g));
+	if (_shape < 1) {
+		// Gamma(a) = Gamma(a + 1) * u^(1/a)
+		u = _dist(_gen);
+		g *= std::pow(_antithetic ? 1 - u : u, 1 / _shape);
 	}
-	return SCALE * (_delay + -1.0 / _rate * std::log(eln));
+	double y = g / _tilted_rate;
+	if (_theta != 0) {
+		_log_weight += _shape * std::log(_rate / _tilted_rate) -
+			(_rate - _tilted_rate) * y;
+	}
+	return SCALE * (_delay + y);
 }
 
+double strsim::erlang_generator::cdf(value_type v) const {
+	// samples are truncated, at most v means below v + 1
+	double x = double(v + 1.0) / SCALE - _delay;
+	if (_shape <= 0) {
+		return (v >= value_type(SCALE * _delay)) ? 1 : 0;
+	}
+	return gamma_p(_shape, _rate * x);
+}
+
+void strsim::erlang_generator::sample_batch(value_type * out, size_t count) {
+	if (_shape <= 0) {
+		std::fill(out, out + count, value_type(SCALE * _delay));
+		return;
+	}
+	// m candidates take m words for the normals, m for the uniforms
+	// and m more for the boost of shapes below 1
+	const size_t m = CANDIDATES;
+	uint32_t words[3 * CANDIDATES];
+	double x[CANDIDATES];
+	// antithetic words are complemented, u = 1 - u exactly
+	const uint32_t flip = _antithetic ? 0xffffffff : 0;
+	const double sign = _antithetic ? -1 : 1;
+	double sum = 0;
+	for (size_t n = 0; n < count; n += m) {
+		_gen.generate(words, (_shape < 1) ? 3 * m : 2 * m);
+		normal_fill(words, x, m / 2);
+		for (size_t i = 0; i < m && n + i < count; ++i) {
+			double g;
+			if (!gamma_accept(_d, _c, sign * x[i],
+					uniform_open(words[m + i] ^ flip), g)) {
+				g = gamma_draw(_spare, _d, _c, _antithetic);
+			}
+			if (_shape < 1) {
+				g *= std::pow(uniform_open(words[2 * m + i] ^ flip),
+						1 / _shape);
+			}
+			double y = g / _tilted_rate;
+			sum += y;
+			out[n + i] = SCALE * (_delay + y);
+		}
+	}
+	if (_theta != 0) {
+		_log_weight += count * _shape * std::log(_rate / _tilted_rate) -
+			(_rate - _tilted_rate) * sum;
+	}
+}
+
+void strsim::gaussian_generator::tilt(double theta) {
+	const double mu = _dist.mean();
+	const double sigma = _dist.stddev();
+	_shift = theta * sigma;
+	// log of P(X >= 0) = Phi(mean / sigma) for the tilted and the
+	// original mean
+	const double scale = sigma * std::sqrt(2.0);
+	_log_norm = std::log(std::erfc(-(mu + _shift) / scale)) -
+		std::log(std::erfc(-mu / scale));
+}
 
 strsim::rnd_generator::value_type strsim::gaussian_generator::sample(void) {
+	const double mu = _dist.mean();
 	double smp = 0;
 	do {
-		smp = _dist(_gen);
+		smp = mu + _shift + _sign * (_dist(_gen) - mu);
 	} while (smp < 0);
+	if (_shift != 0) {
+		const double var = _dist.stddev() * _dist.stddev();
+		_log_weight += -_shift * (smp - mu) / var +
+			_shift * _shift / (2 * var) + _log_norm;
+	}
 	return SCALE * smp;
 }
 
+double strsim::gaussian_generator::cdf(value_type v) const {
+	const double mu = _dist.mean();
+	const double scale = _dist.stddev() * std::sqrt(2.0);
+	double x = double(v + 1.0) / SCALE;
+	// negative draws are redrawn, the latency is the normal above 0
+	return 1 - std::erfc((x - mu) / scale) / std::erfc(-mu / scale);
+}
+
+void strsim::gaussian_generator::sample_batch(value_type * out,
+		size_t count) {
+	uint32_t words[2 * PAIRS];
+	double z[2 * PAIRS];
+	const double mu = _dist.mean() + _shift;
+	const double sigma = _sign * _dist.stddev();
+	std::normal_distribution<double> spare(0, 1);
+	double sum = 0;
+	for (size_t n = 0; n < count; n += 2 * PAIRS) {
+		_gen.generate(words, 2 * PAIRS);
+		normal_fill(words, z, PAIRS);
+		for (size_t i = 0; i < 2 * PAIRS && n + i < count; ++i) {
+			double smp = mu + sigma * z[i];
+			while (smp < 0) {
+				smp = mu + sigma * spare(_spare);
+			}
+			sum += smp;
+			out[n + i] = SCALE * smp;
+		}
+	}
+	if (_shift != 0) {
+		const double var = sigma * sigma;
+		_log_weight += -_shift * (sum - count * _dist.mean()) / var +
+			count * (_shift * _shift / (2 * var) + _log_norm);
+	}
+}
+
+void strsim::exponential_generator::tilt(double theta) {
+	_dist.param(std::exponential_distribution<double>::param_type(
+		_lambda / (1 + theta)));
+}
+
 strsim::rnd_generator::value_type strsim::exponential_generator::sample(void) {
-	return SCALE * _dist(_gen);
+	double e = _dist(_gen);
+	if (_antithetic) {
+		// e = -ln(1 - u) / lambda, the mirror takes -ln(u) / lambda
+		e = -std::log(-std::expm1(-_dist.lambda() * e)) / _dist.lambda();
+	}
+	if (_dist.lambda() != _lambda) {
+		_log_weight += std::log(_lambda / _dist.lambda()) -
+			(_lambda - _dist.lambda()) * e;
+	}
+	return SCALE * e;
+}
+
+double strsim::exponential_generator::cdf(value_type v) const {
+	return -std::expm1(-_lambda * double(v + 1.0) / SCALE);
+}
+
+void strsim::exponential_generator::sample_batch(value_type * out,
+		size_t count) {
+	uint32_t words[BATCH];
+	double e[BATCH];
+	const double lambda = _dist.lambda();
+	double sum = 0;
+	for (size_t n = 0; n < count; n += BATCH) {
+		size_t m = std::min(size_t(BATCH), count - n);
+		_gen.generate(words, m);
+		if (_antithetic) {
+			// complemented words turn every u into 1 - u exactly
+			for (size_t i = 0; i < m; ++i) {
+				words[i] = ~words[i];
+			}
+		}
+		exponential_fill(words, e, m);
+		for (size_t i = 0; i < m; ++i) {
+			out[n + i] = SCALE * (e[i] / lambda);
+			sum += e[i];
+		}
+	}
+	if (lambda != _lambda) {
+		// sum holds the samples times lambda
+		_log_weight += count * std::log(_lambda / lambda) -
+			(_lambda - lambda) * sum / lambda;
+	}
 }
 
 
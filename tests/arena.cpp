@@ -0,0 +1,142 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "code.h"
+#include "store.h"
+#include "event.h"
+
+using namespace std;
+using namespace strsim;
+
+#define RAW_BLOCK 200
+#define CODED_BLOCK 600
+#define NUM_WARMUP 100
+#define NUM_TEST 1000
+#define NUM_LOAD 50
+
+#define MU 4
+#define SIGMA 1
+
+// count every heap allocation made by the program
+static unsigned long num_alloc = 0;
+
+void * operator new(size_t size) {
+	num_alloc++;
+	void * p = malloc(size);
+	if (p == nullptr) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void * p) noexcept {
+	free(p);
+}
+
+/* Run trials the way simulators do and return the number of heap
+ * allocations made after the arena has warmed up */
+unsigned long count_alloc(coder &coder) {
+	gaussian_generator gg(MU, SIGMA);
+	block_arena arena;
+	vector<coded_block*> blocks;
+	unsigned long start = 0;
+	for (unsigned int i = 0; i < NUM_WARMUP + NUM_TEST; ++i) {
+		if (i == NUM_WARMUP) {
+			start = num_alloc;
+		}
+		coder.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
+		for (auto block : blocks) {
+			block->arrieve_time = gg.sample();
+		}
+		sort(blocks.begin(), blocks.end(),
+			[] (coded_block * f, coded_block * s) -> bool {
+				return (f->arrieve_time < s->arrieve_time);
+		});
+		coder.restart();
+		for (auto block : blocks) {
+			coder.decode(block);
+			if (coder.has_finished()) {
+				break;
+			}
+		}
+	}
+	return num_alloc - start;
+}
+
+/* Bounded-window trials as handler of the event engine, which checks
+ * that arrivals come out in time order */
+struct window : event_handler {
+	event_engine &engine;
+	min_coder &coder;
+	gaussian_generator &gg;
+	vector<coded_block*> &blocks;
+	unsigned int issued;
+	bool ordered;
+	time_t last;
+
+	window(event_engine &engine, min_coder &coder, gaussian_generator &gg,
+			vector<coded_block*> &blocks) : engine(engine), coder(coder),
+		gg(gg), blocks(blocks), issued(0), ordered(true), last(0) {}
+
+	void issue(const event &e) {
+		blocks[e.id]->arrieve_time = e.time + gg.sample();
+		engine.schedule(blocks[e.id]->arrieve_time,
+			event_engine::ARRIVE, e.id);
+	}
+
+	void arrive(const event &e) {
+		ordered = ordered && e.time >= last &&
+			e.time == blocks[e.id]->arrieve_time;
+		last = e.time;
+		coder.decode(blocks[e.id]);
+		if (coder.has_finished()) {
+			engine.stop();
+		} else if (issued < blocks.size()) {
+			engine.dispatch(*this, event_engine::ISSUE, issued++);
+		}
+	}
+};
+
+/* Run bounded-window trials on the event engine and return the number
+ * of heap allocations after warm-up, 0 if arrivals come out of order */
+unsigned long count_event_alloc(void) {
+	gaussian_generator gg(MU, SIGMA);
+	min_coder coder;
+	block_arena arena;
+	vector<coded_block*> blocks;
+	// a ring shorter than the latencies, so that about half of the
+	// arrivals wait in the overflow list
+	event_engine engine(12);
+	window w(engine, coder, gg, blocks);
+	unsigned long start = 0;
+	for (unsigned int i = 0; i < NUM_WARMUP + NUM_TEST; ++i) {
+		if (i == NUM_WARMUP) {
+			start = num_alloc;
+		}
+		coder.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
+		coder.restart();
+		engine.reset();
+		w.last = 0;
+		for (w.issued = 0; w.issued < NUM_LOAD; ++w.issued) {
+			engine.schedule(0, event_engine::ISSUE, w.issued);
+		}
+		engine.run(w);
+		w.ordered = w.ordered && coder.has_finished();
+	}
+	return w.ordered ? num_alloc - start : 1;
+}
+
+int main(void) {
+	min_coder mc;
+	luby_coder lc;
+	unsigned long malloc = count_alloc(mc);
+	unsigned long lalloc = count_alloc(lc);
+	cout << "Allocations in " << NUM_TEST << " steady-state trials" << endl;
+	cout << "min_coder: " << malloc << endl;
+	cout << "luby_coder: " << lalloc << endl;
+	unsigned long ealloc = count_event_alloc();
+	cout << "event_engine: " << ealloc << endl;
+	return (malloc == 0 && lalloc == 0 && ealloc == 0) ? 0 : 1;
+}
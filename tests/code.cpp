@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <cstring>
 #include "code.h"
 
 using namespace std;
@@ -8,18 +10,18 @@ using namespace strsim;
 
 #define RAW_BLOCK 20
 #define CODED_BLOCK 40
+#define BLOCK_SIZE 64
 
 int main() {
 	rateless_coder coder;
+	block_arena arena;
 	vector<coded_block*> blocks;
-	coder.encode(RAW_BLOCK, CODED_BLOCK, blocks);
+	coder.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
 	cout << "Generate " << CODED_BLOCK << " coded block(s) from " <<
 		RAW_BLOCK << " raw block(s):" << endl;
 	for (auto b : blocks) {
 		rateless_block *block = static_cast<rateless_block*>(b);
-		for (auto raw : block->raw_blocks) {
-			cout << raw << ", ";
-		}
+		block->for_each([] (unsigned int raw) { cout << raw << ", "; });
 		cout << endl;
 	}
 	cout << "Restore raw block from coded block" << endl;
@@ -33,19 +35,64 @@ int main() {
 	coder.restart();
 	for (auto b : blocks) {
 		rateless_block * block = static_cast<rateless_block*>(b);
-		for (auto raw : block->raw_blocks) {
-			cout << raw << ", ";
-		}
+		block->for_each([] (unsigned int raw) { cout << raw << ", "; });
 		cout << endl;
 		coder.decode(block);
 		if (coder.has_finished()) {
 			break;
 		}
 	}
-	for (auto block : blocks) {
-		delete static_cast<rateless_block*>(block);
+	cout << "Restore raw data from any " << RAW_BLOCK <<
+		" Reed-Solomon block(s)" << endl;
+	rs_coder rs;
+	rs.payload(BLOCK_SIZE);
+	vector<uint8_t> raw(RAW_BLOCK * BLOCK_SIZE);
+	for (auto &byte : raw) {
+		byte = gen();
+	}
+	rs.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
+	rs.encode_payload(raw.data(), arena);
+	shuffle(blocks.begin(), blocks.end(), gen);
+	for (auto b : blocks) {
+		cout << static_cast<rs_block*>(b)->index << ", ";
+		if (rs.decode(b) == 0) {
+			break;
+		}
+	}
+	bool rs_ok = memcmp(rs.data(), raw.data(), raw.size()) == 0;
+	cout << endl << "Restored data " << (rs_ok ? "matches" : "differs") <<
+		endl;
+	cout << "Restore raw data from LT block(s) with inactivation" << endl;
+	luby_coder lt(0.03, 0.5);
+	lt.payload(BLOCK_SIZE);
+	bool lt_ok = true;
+	unsigned int eliminated = 0;
+	for (unsigned int i = 0; i < 20; ++i) {
+		lt.inactivation(false);
+		lt.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
+		lt.encode_payload(raw.data(), arena);
+		shuffle(blocks.begin(), blocks.end(), gen);
+		unsigned int used[2] = {0, 0};
+		for (int mode = 0; mode < 2; ++mode) {
+			lt.inactivation(mode == 1);
+			lt.restart();
+			for (auto b : blocks) {
+				used[mode]++;
+				if (lt.decode(b) == 0) {
+					break;
+				}
+			}
+			lt_ok = lt_ok && lt.has_finished() &&
+				memcmp(lt.data(), raw.data(), raw.size()) == 0;
+		}
+		// elimination finished before peeling alone could
+		eliminated += used[1] < used[0];
 	}
-	blocks.clear();
+	cout << "Restored data " << (lt_ok ? "matches" : "differs") <<
+		", " << eliminated << " of 20 decodings finished by elimination" <<
+		endl;
+	lt_ok = lt_ok && eliminated > 0;
+	return (rs_ok && lt_ok) ? 0 : 1;
 }
 
 
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "pool.h"
+#include "store.h"
+#include "encpool.h"
+
+using namespace std;
+using namespace strsim;
+
+#define NUM_TASK 1000
+#define NUM_WORKER 4
+#define SEED 12345
+#define RAW_BLOCK 50
+#define CODED_BLOCK 60
+#define NUM_ENCODING 40
+
+/* Run uneven seeded tasks, count how often each one runs and sum the
+ * samples drawn by each worker */
+unsigned long run(unsigned int workers, vector<unsigned int> &runs) {
+	task_pool pool(workers);
+	vector<unsigned long> sum(pool.workers(), 0);
+	vector<gaussian_generator> gen(pool.workers(),
+			gaussian_generator(4.0, 1.0));
+	runs.assign(NUM_TASK, 0);
+	unsigned int last = 0;
+	bool ordered = true;
+	pool.run(NUM_TASK,
+		[&] (unsigned int id, unsigned int w) {
+			runs[id]++;
+			gen[w].seed(SEED, id);
+			// the cost of a task grows with its id
+			for (unsigned int i = 0; i < id; ++i) {
+				sum[w] += gen[w].sample();
+			}
+		},
+		[&] (unsigned int done) {
+			ordered = ordered && (done == last + 1);
+			last = done;
+		});
+	unsigned long total = 0;
+	for (auto s : sum) {
+		total += s;
+	}
+	return (ordered && last == NUM_TASK) ? total : 0;
+}
+
+/* Empty temporary file for the pool under $TMPDIR, /tmp by default,
+ * empty string if none can be made */
+string temp_file(void) {
+	const char * dir = getenv("TMPDIR");
+	string path = string((dir && *dir) ? dir : "/tmp") + "/testpoolXXXXXX";
+	int fd = mkstemp(&path[0]);
+	if (fd < 0) {
+		return "";
+	}
+	close(fd);
+	return path;
+}
+
+/* Build a pool of encodings in path and read its file back */
+string build(const string &path, unsigned int workers,
+		encoding_pool &encodings) {
+	task_pool pool(workers);
+	encoding_pool::coder_factory make = [] () {
+		return new luby_coder(0.03, 0.5);
+	};
+	if (path.empty() || !encodings.build(path, make, RAW_BLOCK, CODED_BLOCK,
+			NUM_ENCODING, SEED, pool)) {
+		return "";
+	}
+	ostringstream bytes;
+	bytes << ifstream(path, ios::binary).rdbuf();
+	return bytes.str();
+}
+
+/* Whether encodings drawn from the pool still decode */
+bool decodes(const encoding_pool &encodings) {
+	luby_coder coder(0.03, 0.5);
+	coder.pool(&encodings);
+	block_arena arena;
+	vector<coded_block *> blocks;
+	for (unsigned int i = 0; i < NUM_ENCODING; ++i) {
+		coder.seed(SEED, i);
+		coder.encode(RAW_BLOCK, CODED_BLOCK, arena, blocks);
+		unsigned int left = RAW_BLOCK;
+		for (auto b : blocks) {
+			left = coder.decode(b);
+		}
+		if (left != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void) {
+	vector<unsigned int> single;
+	vector<unsigned int> multi;
+	unsigned long ssum = run(1, single);
+	unsigned long msum = run(NUM_WORKER, multi);
+	bool once = true;
+	for (unsigned int i = 0; i < NUM_TASK; ++i) {
+		once = once && single[i] == 1 && multi[i] == 1;
+	}
+	cout << "Every task ran once: " << once << endl;
+	cout << "Sum with 1 worker: " << ssum << endl;
+	cout << "Sum with " << NUM_WORKER << " workers: " << msum << endl;
+	encoding_pool single_pool;
+	encoding_pool multi_pool;
+	string path = temp_file();
+	string sbytes = build(path, 1, single_pool);
+	string mbytes = build(path, NUM_WORKER, multi_pool);
+	encoding_pool other;
+	string degree = luby_coder(0.03, 0.5).degree();
+	bool reopen = other.open(path, RAW_BLOCK, CODED_BLOCK, degree,
+			SEED) && other.size() == NUM_ENCODING &&
+		!other.open(path, RAW_BLOCK, CODED_BLOCK + 1, degree, SEED) &&
+		!other.open(path, RAW_BLOCK, CODED_BLOCK, degree, SEED + 1);
+	bool same = !sbytes.empty() && sbytes == mbytes;
+	bool decoded = decodes(multi_pool);
+	cout << "Same encoding pool with 1 and " << NUM_WORKER <<
+		" workers: " << same << endl;
+	cout << "Pool only opens with its parameters: " << reopen << endl;
+	cout << "Encodings drawn from the pool decode: " << decoded << endl;
+	if (!path.empty()) {
+		remove(path.c_str());
+	}
+	return (once && ssum != 0 && ssum == msum && same && reopen &&
+		decoded) ? 0 : 1;
+}
@@ -1,18 +1,480 @@
 #include "code.h"
 #include "store.h"
+#include "simd.h"
+#include "tail.h"
+#include "kofn.h"
 #include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
 
 using namespace std;
 using namespace strsim;
 
 #define NUM_BLOCKS 20
 #define NUM_TEST 10000
+#define NUM_SAMPLE 200000
+#define SEED 12345
+// mean shift of the tilted exponential in the weighted tail test
+#define TILT 8
+// normal quantile of the p99.9 and largest shift the importance
+// sampling test aims with
+#define IS_Z 3.09
+#define IS_CAP 1.0
+// points of the quasi-random tests, 2^QMC_BITS
+#define QMC_BITS 8
 
 #define SHAPE 3
 #define RATE 2.0
 #define DELAY 1.0
+// time scale of the generators in store.cpp
+#define SCALE 1000
+
+#define ROBUST_C 0.1
+#define ROBUST_DELTA 0.5
+
+/* Known answers of Philox4x32-10 from the Random123 test vectors */
+bool test_philox(void) {
+	const uint32_t expect[3][4] = {
+		{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+		{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+		{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1},
+	};
+	const uint64_t key[3] = {0, ~uint64_t(0), 0x299f31d0a4093822};
+	const uint64_t stream[3] = {0, ~uint64_t(0), 0x0370734413198a2e};
+	const uint64_t index[3] = {0, ~uint64_t(0), 0x85a308d3243f6a88};
+	bool ok = true;
+	for (unsigned int i = 0; i < 3; ++i) {
+		uint32_t out[4];
+		philox::block(key[i], stream[i], index[i], out);
+		for (unsigned int j = 0; j < 4; ++j) {
+			ok = ok && out[j] == expect[i][j];
+		}
+	}
+	// the engine, discard and bulk generation walk the same stream
+	philox a(7, 3);
+	philox b(7, 3);
+	vector<uint32_t> words(10);
+	b.discard(3);
+	b.generate(words.data(), words.size());
+	for (unsigned int i = 0; i < 3; ++i) {
+		a();
+	}
+	for (auto w : words) {
+		ok = ok && a() == w;
+	}
+	return ok;
+}
+
+/* The first 2^m scrambled Sobol points put one coordinate in each
+ * interval of size 2^-m in every dimension, and one point in each
+ * elementary box of area 2^-m of the first two dimensions */
+bool test_sobol(void) {
+	const unsigned int n = 1 << QMC_BITS;
+	vector<uint32_t> words(size_t(n) * sobol::DIMS);
+	philox gen(11, 5);
+	for (unsigned int p = 0; p < n; ++p) {
+		gen.quasi(p);
+		gen.generate(&words[size_t(p) * sobol::DIMS], sobol::DIMS);
+	}
+	bool ok = true;
+	for (unsigned int d = 0; d < sobol::DIMS; ++d) {
+		vector<bool> seen(n, false);
+		for (unsigned int p = 0; p < n; ++p) {
+			uint32_t cell = words[size_t(p) * sobol::DIMS + d] >>
+				(32 - QMC_BITS);
+			ok = ok && !seen[cell];
+			seen[cell] = true;
+		}
+	}
+	for (unsigned int a = 0; a <= QMC_BITS; ++a) {
+		vector<bool> seen(n, false);
+		for (unsigned int p = 0; p < n; ++p) {
+			uint32_t x = words[size_t(p) * sobol::DIMS];
+			uint32_t y = words[size_t(p) * sobol::DIMS + 1];
+			uint32_t box = (a == 0 ? 0 : x >> (32 - a)) <<
+				(QMC_BITS - a);
+			box |= (a == QMC_BITS) ? 0 : y >> (32 - QMC_BITS + a);
+			ok = ok && !seen[box];
+			seen[box] = true;
+		}
+	}
+	cout << "Test scrambled Sobol nets: " << (ok ? "ok" : "failed") << endl;
+	return ok;
+}
+
+/* A batch and its antithetic batch from the same stream are
+ * negatively correlated */
+template <typename G>
+bool test_antithetic(G gen, const char * name) {
+	vector<rnd_generator::value_type> x(NUM_SAMPLE);
+	vector<rnd_generator::value_type> y(NUM_SAMPLE);
+	gen.seed(3, 9);
+	gen.sample_batch(x.data(), NUM_SAMPLE);
+	gen.seed(3, 9);
+	gen.antithetic(true);
+	gen.sample_batch(y.data(), NUM_SAMPLE);
+	double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+	for (unsigned int i = 0; i < NUM_SAMPLE; ++i) {
+		sx += x[i];
+		sy += y[i];
+		sxx += double(x[i]) * x[i];
+		syy += double(y[i]) * y[i];
+		sxy += double(x[i]) * y[i];
+	}
+	double cov = sxy / NUM_SAMPLE - sx * sy / NUM_SAMPLE / NUM_SAMPLE;
+	double corr = cov / sqrt(sxx / NUM_SAMPLE - sx * sx / NUM_SAMPLE /
+		NUM_SAMPLE) / sqrt(syy / NUM_SAMPLE - sy * sy / NUM_SAMPLE /
+		NUM_SAMPLE);
+	bool ok = corr < -0.5;
+	cout << "Test " << name << " antithetic correlation: " << corr <<
+		(ok ? " ok" : " failed") << endl;
+	return ok;
+}
+
+/* Tilted samples weighted by their likelihood ratio keep the mean of
+ * the latency, single samples and batches of one alike */
+template <typename G>
+bool test_tilt(G gen, double theta, const char * name) {
+	vector<rnd_generator::value_type> plain(NUM_SAMPLE);
+	gen.sample_batch(plain.data(), NUM_SAMPLE);
+	double mean = 0;
+	for (auto x : plain) {
+		mean += double(x) / NUM_SAMPLE;
+	}
+	gen.tilt(theta);
+	bool ok = true;
+	for (int batch = 0; batch < 2; ++batch) {
+		gen.seed(5, batch);
+		double wsum = 0, wmean = 0, last = 0;
+		for (unsigned int i = 0; i < NUM_SAMPLE; ++i) {
+			rnd_generator::value_type x;
+			if (batch) {
+				gen.sample_batch(&x, 1);
+			} else {
+				x = gen.sample();
+			}
+			double w = exp(gen.log_weight() - last);
+			last = gen.log_weight();
+			wsum += w / NUM_SAMPLE;
+			wmean += w * x / NUM_SAMPLE;
+		}
+		bool match = fabs(wsum - 1) < 0.02 &&
+			fabs(wmean - mean) < 0.02 * mean;
+		cout << "Test " << name << (batch ? " batch" : " single") <<
+			" tilt: weight " << wsum << ", mean " << wmean << " vs " <<
+			mean << (match ? " ok" : " failed") << endl;
+		ok = ok && match;
+	}
+	return ok;
+}
+
+/* Deep quantiles of a tilted exponential latency match the exact ones
+ * within 2% and fall in their confidence intervals */
+bool test_weighted_tail(void) {
+	const unsigned int n = NUM_SAMPLE / 10;
+	exponential_generator gen(RATE);
+	gen.tilt(TILT);
+	weighted_tail tail;
+	double last = 0;
+	for (unsigned int i = 0; i < n; ++i) {
+		rnd_generator::value_type x = gen.sample();
+		tail.add(x, exp(gen.log_weight() - last));
+		last = gen.log_weight();
+	}
+	bool ok = true;
+	const double q[3] = {0.999, 0.9999, 0.99999};
+	for (double p : q) {
+		double exact = -SCALE * log(1 - p) / RATE;
+		double lo, hi;
+		tail.interval(p, 3, lo, hi);
+		double est = tail.quantile(p);
+		bool match = fabs(est - exact) < 0.02 * exact && lo <= exact + 1 &&
+			exact <= hi + 1;
+		cout << "Test tilted p" << p * 100 << ": " << est << " in [" << lo <<
+			", " << hi << "] vs " << exact << (match ? " ok" : " failed") <<
+			endl;
+		ok = ok && match;
+	}
+	return ok;
+}
+
+/* The cdf of a generator is within 0.005 of the empirical cdf of its
+ * samples everywhere (Kolmogorov-Smirnov distance) */
+bool test_cdf(rnd_generator &gen, const char * name) {
+	vector<rnd_generator::value_type> sample(NUM_SAMPLE);
+	gen.sample_batch(sample.data(), sample.size());
+	sort(sample.begin(), sample.end());
+	double dist = 0;
+	for (size_t i = 0; i < sample.size(); ++i) {
+		// only the last of equal samples has the empirical cdf
+		if (i + 1 < sample.size() && sample[i + 1] == sample[i]) {
+			continue;
+		}
+		double f = gen.cdf(sample[i]);
+		dist = max(dist, fabs(f - double(i + 1) / NUM_SAMPLE));
+		if (sample[i] > 0) {
+			// just below the sample, before its own mass
+			double before = gen.cdf(sample[i] - 1);
+			size_t below = lower_bound(sample.begin(), sample.end(),
+				sample[i]) - sample.begin();
+			dist = max(dist, fabs(before - double(below) / NUM_SAMPLE));
+		}
+	}
+	bool ok = dist < 0.005;
+	cout << "Test " << name << " cdf: distance " << dist <<
+		(ok ? " ok" : " failed") << endl;
+	return ok;
+}
+
+/* The exact mean and p99 of the m-th of n arrivals match Monte Carlo
+ * trials, the mean within 4 standard errors and p99 within 2% */
+bool test_kofn_exact(const kofn_exact &exact, unsigned int m,
+		const vector<pair<unsigned int, rnd_generator *> > &groups,
+		const char * name) {
+	kofn_trial trial;
+	vector<double> done;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		trial.clear();
+		for (auto &g : groups) {
+			trial.sample(g.first, *g.second);
+		}
+		done.push_back(trial.select(m));
+	}
+	sort(done.begin(), done.end());
+	double sum = 0, sq = 0;
+	for (double t : done) {
+		sum += t;
+		sq += t * t;
+	}
+	double mean = sum / NUM_TEST;
+	double se = sqrt((sq / NUM_TEST - mean * mean) / NUM_TEST);
+	double p99 = done[size_t(0.99 * NUM_TEST)];
+	double emean = exact.mean(m);
+	double ep99 = exact.quantile(m, 0.99);
+	bool ok = fabs(mean - emean) < 4 * se && fabs(p99 - ep99) < 0.02 * ep99;
+	cout << "Test exact " << name << ": mean " << emean << " vs " << mean <<
+		" (se " << se << "), p99 " << ep99 << " vs " << p99 <<
+		(ok ? " ok" : " failed") << endl;
+	return ok;
+}
+
+/* Importance sampling of the m-th of n Gaussian arrivals, tilted as the
+ * simulators aim it, agrees with plain sampling: the means within 4
+ * combined standard errors and the 95% intervals of the p99 overlap,
+ * with at least a quarter of the trials effective */
+bool test_importance(unsigned int m, unsigned int n, const char * name) {
+	gaussian_generator plain(4.0, 1.0), tilted(4.0, 1.0);
+	double shift = importance_shift(order_correlation({{1, 4.0, 1.0}},
+		m, n), IS_Z, IS_CAP);
+	tilted.tilt(shift / sqrt(double(n)));
+	kofn_trial trial;
+	vector<time_t> done;
+	weighted_tail weighted;
+	double sum = 0, sq = 0;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		trial.clear();
+		plain.seed(SEED, i);
+		trial.sample(n, plain);
+		done.push_back(trial.select(m));
+		sum += done.back();
+		sq += double(done.back()) * done.back();
+		trial.clear();
+		tilted.seed(SEED + 1, i);
+		trial.sample(n, tilted);
+		weighted.add(trial.select(m), exp(tilted.log_weight()));
+	}
+	sort(done.begin(), done.end());
+	double mean = sum / NUM_TEST;
+	double se = sqrt((sq / NUM_TEST - mean * mean) / NUM_TEST);
+	// order statistics around the p99 of the plain trials
+	double half = 1.96 * sqrt(NUM_TEST * 0.99 * 0.01);
+	double lo = done[size_t(0.99 * NUM_TEST - half)];
+	double hi = done[min(size_t(0.99 * NUM_TEST + half), done.size() - 1)];
+	double wlo, whi;
+	weighted.interval(0.99, 1.96, wlo, whi);
+	double ess = weighted.effective_size();
+	bool ok = ess > NUM_TEST / 4 &&
+		fabs(weighted.mean() - mean) <
+			4 * sqrt(se * se + pow(weighted.std_error(), 2)) &&
+		wlo <= hi && lo <= whi;
+	cout << "Test importance " << name << ": shift " << shift << ", " <<
+		ess << " effective, mean " << weighted.mean() << " vs " << mean <<
+		", p99 " << weighted.quantile(0.99) << " [" << wlo << ", " << whi <<
+		"] vs " << done[size_t(0.99 * NUM_TEST)] << " [" << lo << ", " <<
+		hi << "]" << (ok ? " ok" : " failed") << endl;
+	return ok;
+}
+
+/* Batches follow the same distribution as single samples, mean and
+ * standard deviation agree within 1% */
+bool test_batch(rnd_generator &gen, const char * name) {
+	vector<rnd_generator::value_type> batch(NUM_SAMPLE);
+	gen.sample_batch(batch.data(), batch.size());
+	double bsum = 0, bsq = 0, ssum = 0, ssq = 0;
+	for (auto x : batch) {
+		bsum += x;
+		bsq += double(x) * x;
+		double y = gen.sample();
+		ssum += y;
+		ssq += y * y;
+	}
+	double bmean = bsum / NUM_SAMPLE, smean = ssum / NUM_SAMPLE;
+	double bstd = sqrt(bsq / NUM_SAMPLE - bmean * bmean);
+	double sstd = sqrt(ssq / NUM_SAMPLE - smean * smean);
+	bool ok = fabs(bmean - smean) < 0.01 * smean &&
+		fabs(bstd - sstd) < 0.01 * sstd;
+	cout << "Test " << name << " batches: mean " << bmean << " vs " <<
+		smean << ", stddev " << bstd << " vs " << sstd <<
+		(ok ? " ok" : " failed") << endl;
+	return ok;
+}
+
+/* The former Erlang sampler, the log of a product of shape uniforms,
+ * at the scale of store.cpp */
+double erlang_product(mt19937 &gen, unsigned int shape) {
+	uniform_real_distribution<double> dist(0, 1);
+	double eln = 1.0;
+	for (unsigned int i = 0; i < shape; ++i) {
+		eln *= dist(gen);
+	}
+	return SCALE * (DELAY + -1.0 / RATE * log(eln));
+}
+
+/* Quantiles of the gamma sampler, single and batched, match the former
+ * sampler within 1%, and mean and standard deviation match the gamma
+ * distribution for shapes it could not sample */
+bool test_gamma(void) {
+	mt19937 gen(1);
+	vector<double> product(NUM_SAMPLE);
+	for (auto &x : product) {
+		x = erlang_product(gen, SHAPE);
+	}
+	erlang_generator eg(SHAPE, RATE, DELAY);
+	vector<rnd_generator::value_type> batch(NUM_SAMPLE);
+	vector<rnd_generator::value_type> single(NUM_SAMPLE);
+	eg.sample_batch(batch.data(), NUM_SAMPLE);
+	for (auto &x : single) {
+		x = eg.sample();
+	}
+	sort(product.begin(), product.end());
+	sort(batch.begin(), batch.end());
+	sort(single.begin(), single.end());
+	bool ok = true;
+	const double q[4] = {0.1, 0.5, 0.9, 0.99};
+	for (double p : q) {
+		size_t i = NUM_SAMPLE * p;
+		bool match = fabs(batch[i] - product[i]) < 0.01 * product[i] &&
+			fabs(single[i] - product[i]) < 0.01 * product[i];
+		cout << "Test Erlang p" << p * 100 << ": " << product[i] <<
+			" former, " << single[i] << " single, " << batch[i] <<
+			" batch" << (match ? " ok" : " failed") << endl;
+		ok = ok && match;
+	}
+	const double shapes[3] = {0.5, 2.5, 200};
+	for (double shape : shapes) {
+		erlang_generator sg(shape, RATE, DELAY);
+		sg.sample_batch(batch.data(), NUM_SAMPLE);
+		double sum = 0, sq = 0;
+		for (auto x : batch) {
+			sum += x;
+			sq += double(x) * x;
+		}
+		double mean = sum / NUM_SAMPLE;
+		double stddev = sqrt(sq / NUM_SAMPLE - mean * mean);
+		double emean = SCALE * (DELAY + shape / RATE);
+		double estddev = SCALE * sqrt(shape) / RATE;
+		bool match = fabs(mean - emean) < 0.01 * emean &&
+			fabs(stddev - estddev) < 0.01 * estddev;
+		cout << "Test Gamma shape " << shape << ": mean " << mean <<
+			" vs " << emean << ", stddev " << stddev << " vs " <<
+			estddev << (match ? " ok" : " failed") << endl;
+		ok = ok && match;
+	}
+	return ok;
+}
+
+/* Subsets of 3 of 6 values should be equally likely, and drawing all
+ * of the values should give each of them once */
+bool test_subset(void) {
+	const unsigned int n = 6;
+	const unsigned int d = 3;
+	philox gen(SEED, 0);
+	subset_sampler sampler;
+	sampler.reset(n);
+	vector<unsigned long> count(1 << n, 0);
+	for (unsigned int i = 0; i < NUM_SAMPLE; ++i) {
+		unsigned int mask = 0;
+		sampler.sample(d, gen, [&] (unsigned int v) { mask |= 1 << v; });
+		count[mask]++;
+	}
+	// chi-square over the 20 subsets, 43.8 is its 0.999 quantile
+	double expected = double(NUM_SAMPLE) / 20;
+	double chi2 = 0;
+	for (unsigned int mask = 0; mask < count.size(); ++mask) {
+		if (__builtin_popcount(mask) == d) {
+			chi2 += pow(count[mask] - expected, 2) / expected;
+		}
+	}
+	bool uniform = chi2 < 43.8;
+	bool distinct = true;
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		unsigned int mask = 0;
+		sampler.sample(n, gen, [&] (unsigned int v) { mask |= 1 << v; });
+		distinct = distinct && mask == (1u << n) - 1;
+	}
+	cout << "Test subset sampler: chi-square " << chi2 << ", all values " <<
+		(distinct ? "distinct" : "repeated") <<
+		(uniform && distinct ? " ok" : " failed") << endl;
+	return uniform && distinct;
+}
 
 int main(void) {
+	global_seed(SEED);
+	bool philox_ok = test_philox();
+	cout << "Test Philox engine: " << (philox_ok ? "ok" : "failed") << endl;
+	cout << "Math kernel: " << math_kernel() << endl;
+	gaussian_generator gg(4.0, 1.0);
+	exponential_generator xg(RATE);
+	erlang_generator eg(SHAPE, RATE, DELAY);
+	bool batch_ok = test_batch(gg, "Gaussian");
+	batch_ok = test_batch(xg, "Exponential") && batch_ok;
+	batch_ok = test_batch(eg, "Erlang") && batch_ok;
+	bool gamma_ok = test_gamma();
+	bool vr_ok = test_sobol();
+	vr_ok = test_antithetic(gaussian_generator(4.0, 1.0), "Gaussian") && vr_ok;
+	vr_ok = test_antithetic(exponential_generator(RATE), "Exponential") &&
+		vr_ok;
+	vr_ok = test_antithetic(erlang_generator(SHAPE, RATE, DELAY), "Erlang") &&
+		vr_ok;
+	bool is_ok = test_tilt(gaussian_generator(4.0, 1.0), 0.5, "Gaussian");
+	is_ok = test_tilt(exponential_generator(RATE), 0.5, "Exponential") &&
+		is_ok;
+	is_ok = test_tilt(erlang_generator(SHAPE, RATE, DELAY), 0.5, "Erlang") &&
+		is_ok;
+	is_ok = test_weighted_tail() && is_ok;
+	is_ok = test_importance(100, 150, "100 of 150") && is_ok;
+	is_ok = test_importance(100, 100, "100 of 100") && is_ok;
+	bool subset_ok = test_subset();
+	bool exact_ok = test_cdf(gg, "Gaussian");
+	exact_ok = test_cdf(xg, "Exponential") && exact_ok;
+	exact_ok = test_cdf(eg, "Erlang") && exact_ok;
+	gaussian_generator slow(8.0, 2.0);
+	kofn_exact exact;
+	exact.add(30, cdf_of(gg));
+	exact_ok = test_kofn_exact(exact, 20, {{30, &gg}}, "20 of 30") &&
+		exact_ok;
+	exact.clear();
+	exact.add(5, cdf_of(slow));
+	exact.add(25, cdf_of(gg));
+	exact_ok = test_kofn_exact(exact, 20, {{5, &slow}, {25, &gg}},
+		"20 of 5 slow and 25 fast") && exact_ok;
+	exact.clear();
+	exact.add(30, mixture(0.2, cdf_of(slow), cdf_of(eg)));
+	exact_ok = (fabs(exact.cdf(30, 4000) - pow(0.2 * slow.cdf(4000) +
+		0.8 * eg.cdf(4000), 30)) < 1e-12) && exact_ok;
+
 	unsigned int * degrees = new unsigned int [NUM_BLOCKS];
 	
 	for (unsigned int i = 0; i < NUM_BLOCKS; ++i) {
@@ -27,6 +489,18 @@ int main(void) {
 		cout << i+1 << "," << double(degrees[i]) / NUM_TEST << endl;
 	}
 	
+	for (unsigned int i = 0; i < NUM_BLOCKS; ++i) {
+		degrees[i] = 0;
+	}
+	cout << "Test Robust Soliton Distribution Generator" << endl;
+	robust_soliton_generator rsg(ROBUST_C, ROBUST_DELTA, NUM_BLOCKS);
+	for (unsigned int i = 0; i < NUM_TEST; ++i) {
+		degrees[rsg.sample() - 1]++;
+	}
+	for (unsigned int i = 0; i < NUM_BLOCKS; ++i) {
+		cout << i+1 << "," << double(degrees[i]) / NUM_TEST << endl;
+	}
+	
 	for (unsigned int i = 0; i < NUM_BLOCKS; ++i) {
 		degrees[i] = 0;
 	}
@@ -49,6 +523,7 @@ int main(void) {
 	}
 	*/
 	
-	return 0;
+	return (philox_ok && batch_ok && gamma_ok && vr_ok && is_ok &&
+		exact_ok && subset_ok) ? 0 : 1;
 }
 